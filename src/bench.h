@@ -0,0 +1,155 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Harness shared by the bench*.c programs. Include it from exactly one
+ * file per program; it defines malloc() and friends.
+ *
+ * A benchmark is a function that does its operation n times. bench_run()
+ * calls it with a growing n until one run lasts TTK_BENCH_MS milliseconds
+ * (default 500), then prints one JSON line per benchmark on stdout:
+ *
+ *   {"bench":"menu_scroll/10000","n":2048,"ns_per_op":5120.3,
+ *    "allocs_per_op":4.00,"bytes_per_op":3528.0}
+ *
+ * (all on one line). Allocations are counted by wrapping glibc's
+ * allocator; elsewhere both alloc fields are -1. Only benchmarks whose
+ * name contains argv[1], if given, are run.
+ *
+ * Run the programs from the top of the TTK tree so fonts/ and schemes/
+ * are found. TTK_BENCH_SCREEN=WxHxBPP overrides the 220x176x16 screen.
+ */
+
+#ifndef _TTK_BENCH_H_
+#define _TTK_BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ttk.h"
+
+static const char* bench_filter;
+static long long bench_goal = 500000000LL;
+static long long bench_elapsed, bench_started;
+static long bench_allocs, bench_bytes;
+static int bench_counting;
+
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    if (bench_counting) bench_allocs++, bench_bytes += size;
+    return __libc_malloc(size);
+}
+void* calloc(size_t n, size_t size) {
+    if (bench_counting) bench_allocs++, bench_bytes += n * size;
+    return __libc_calloc(n, size);
+}
+void* realloc(void* ptr, size_t size) {
+    if (bench_counting) bench_allocs++, bench_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+void free(void* ptr) { __libc_free(ptr); }
+#define BENCH_COUNTS_ALLOCS 1
+#else
+#define BENCH_COUNTS_ALLOCS 0
+#endif
+
+static long long bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Leave setup work out of the numbers by bracketing it with these.
+static void bench_pause() {
+    bench_elapsed += bench_now() - bench_started;
+    bench_counting = 0;
+}
+static void bench_resume() {
+    bench_counting = 1;
+    bench_started = bench_now();
+}
+
+static void bench_run(const char* name, void (*fn)(long n, void* arg),
+                      void* arg) {
+    long n = 1, next;
+    long long wall = bench_now();
+
+    if (bench_filter && !strstr(name, bench_filter)) return;
+
+    for (;;) {
+        bench_elapsed = 0;
+        bench_allocs = bench_bytes = 0;
+        bench_resume();
+        fn(n, arg);
+        bench_pause();
+        if (bench_elapsed >= bench_goal || n >= 1000000000L) break;
+        // paused setup can dwarf what's measured; don't let it run away
+        if (bench_now() - wall >= 10 * bench_goal) break;
+
+        // aim a bit past the goal, growing between 2x and 100x per round
+        if (bench_elapsed > 0)
+            next = (long)(bench_goal * 6 / 5 * (double)n / bench_elapsed);
+        else
+            next = n * 100;
+        if (next < n * 2) next = n * 2;
+        if (next > n * 100) next = n * 100;
+        n = next;
+    }
+
+    if (BENCH_COUNTS_ALLOCS)
+        printf(
+            "{\"bench\":\"%s\",\"n\":%ld,\"ns_per_op\":%.1f,"
+            "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+            name, n, (double)bench_elapsed / n, (double)bench_allocs / n,
+            (double)bench_bytes / n);
+    else
+        printf(
+            "{\"bench\":\"%s\",\"n\":%ld,\"ns_per_op\":%.1f,"
+            "\"allocs_per_op\":-1,\"bytes_per_op\":-1}\n",
+            name, n, (double)bench_elapsed / n);
+    fflush(stdout);
+}
+
+// Parses the arguments and environment, then brings TTK up on an
+// emulated screen with the given scheme loaded (0 for none).
+static TWindow* bench_init(int argc, char** argv, const char* scheme) {
+    int w = 220, h = 176, bpp = 16;
+    const char* env;
+    TWindow* win;
+
+    if (argc > 1) bench_filter = argv[1];
+    if ((env = getenv("TTK_BENCH_MS")) && atoi(env) > 0)
+        bench_goal = atoi(env) * 1000000LL;
+    if ((env = getenv("TTK_BENCH_SCREEN")))
+        sscanf(env, "%dx%dx%d", &w, &h, &bpp);
+
+    ttk_set_emulation(w, h, bpp);
+    win = ttk_init();
+    ttk_menufont = ttk_get_font("Chicago", 12);
+    ttk_textfont = ttk_get_font("Espy Sans", 10);
+    if (scheme) ttk_ap_load(scheme);
+    return win;
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Appearance fills, blits and the 2bpp dither.
+
+#include "bench.h"
+#include "imgview.h"
+
+extern ttk_screeninfo* ttk_screen;
+static TWindow* win;
+
+typedef struct fill_case {
+    TApItem ap;
+    int w, h;
+} fill_case;
+
+static void bench_fill(long n, void* arg) {
+    fill_case* c = arg;
+    while (n--) ttk_ap_fillrect(win->srf, &c->ap, 0, 0, c->w, c->h);
+}
+
+typedef struct blit_case {
+    ttk_surface src;
+    int w, h;
+} blit_case;
+
+static void bench_blit(long n, void* arg) {
+    blit_case* c = arg;
+    while (n--) ttk_blit_image_ex(c->src, 0, 0, c->w, c->h, win->srf, 0, 0);
+}
+
+static void bench_dither(long n, void* arg) {
+    ttk_surface src = arg, copy;
+
+    while (n--) {
+        bench_pause();
+        copy = ttk_new_surface(ttk_screen->w, ttk_screen->h, 16);
+        ttk_blit_image(src, copy, 0, 0);
+        bench_resume();
+        copy = ttk_floyd_steinberg_dither(copy);
+        bench_pause();
+        ttk_free_surface(copy);
+        bench_resume();
+    }
+}
+
+static void run_fills() {
+    fill_case c;
+    char name[64];
+    int sz;
+
+    for (sz = 0; sz < 2; sz++) {
+        const char* szname = sz ? "screen" : "row";
+        memset(&c, 0, sizeof(c));
+        c.w = ttk_screen->w;
+        c.h = sz ? ttk_screen->h : 20;
+        c.ap.name = "bench";
+        c.ap.gradstart = ttk_makecol(255, 255, 255);
+        c.ap.gradend = ttk_makecol(40, 80, 160);
+        c.ap.gradmid = ttk_makecol(120, 160, 220);
+        c.ap.gradwith = ttk_makecol(200, 200, 200);
+        c.ap.color = ttk_makecol(40, 80, 160);
+
+        c.ap.type = TTK_AP_COLOR;
+        sprintf(name, "ap_fill/solid/%s", szname);
+        bench_run(name, bench_fill, &c);
+
+        c.ap.type = TTK_AP_GRADIENT;
+        sprintf(name, "ap_fill/vgrad/%s", szname);
+        bench_run(name, bench_fill, &c);
+
+        c.ap.type = TTK_AP_GRADIENT | TTK_AP_GRAD_HORIZ;
+        sprintf(name, "ap_fill/hgrad/%s", szname);
+        bench_run(name, bench_fill, &c);
+
+        c.ap.type = TTK_AP_GRADIENT | TTK_AP_GRAD_MID;
+        sprintf(name, "ap_fill/midgrad/%s", szname);
+        bench_run(name, bench_fill, &c);
+
+        c.ap.type = TTK_AP_GRADIENT | TTK_AP_ROUNDING;
+        c.ap.rounding = 5;
+        sprintf(name, "ap_fill/rounded/%s", szname);
+        bench_run(name, bench_fill, &c);
+
+        c.ap.type = TTK_AP_GRADIENT | TTK_AP_GRAD_BAR | TTK_AP_GRAD_TPERC |
+                    TTK_AP_GRAD_BPERC;
+        c.ap.rounding = 0;
+        c.ap.gbt = c.ap.gbb = 40;
+        c.ap.gbl = c.ap.gbr = 2;
+        sprintf(name, "ap_fill/bar/%s", szname);
+        bench_run(name, bench_fill, &c);
+    }
+}
+
+static void run_blits() {
+    blit_case c;
+    int x;
+
+    // a full-screen window surface, as in compositing
+    c.w = ttk_screen->w;
+    c.h = ttk_screen->h;
+    c.src = ttk_new_surface(c.w, c.h, ttk_screen->bpp);
+    ttk_vgradient(c.src, 0, 0, c.w, c.h, ttk_makecol(255, 255, 255),
+                  ttk_makecol(0, 0, 0));
+    bench_run("blit/screen", bench_blit, &c);
+    ttk_free_surface(c.src);
+
+    // a color-keyed menu row, half of it transparent
+    c.w = ttk_screen->w;
+    c.h = 20;
+    c.src = ttk_new_surface(c.w, c.h, ttk_screen->bpp);
+    for (x = 0; x < c.w / 2; x += 8)
+        ttk_fillrect(c.src, x, 4, x + 5, 15, ttk_makecol(BLACK));
+    bench_run("blit/row_keyed", bench_blit, &c);
+    ttk_free_surface(c.src);
+
+    // a 32bpp image onto the screen, which needs converting
+    c.w = ttk_screen->w;
+    c.h = ttk_screen->h;
+    c.src = ttk_new_surface(c.w, c.h, 32);
+    ttk_hgradient(c.src, 0, 0, c.w, c.h, ttk_makecol_ex(255, 0, 0, c.src),
+                  ttk_makecol_ex(0, 0, 255, c.src));
+    bench_run("blit/convert32", bench_blit, &c);
+    ttk_free_surface(c.src);
+}
+
+int main(int argc, char** argv) {
+    ttk_surface photo;
+
+    win = bench_init(argc, argv, "schemes/mono.cs");
+
+    run_fills();
+    run_blits();
+
+    // dithering a screen-sized photo for a 2bpp display
+    photo = ttk_new_surface(ttk_screen->w, ttk_screen->h, 16);
+    ttk_vgradient(photo, 0, 0, ttk_screen->w, ttk_screen->h,
+                  ttk_makecol_ex(250, 220, 180, photo),
+                  ttk_makecol_ex(20, 40, 90, photo));
+    ttk_fillellipse(photo, ttk_screen->w / 2, ttk_screen->h / 2, 40, 30,
+                    ttk_makecol_ex(200, 60, 40, photo));
+    bench_run("dither/screen", bench_dither, photo);
+    ttk_free_surface(photo);
+
+    ttk_quit();
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Menus the size of a music library: building, appending, sorting,
+// idling and scrolling.
+
+#include "bench.h"
+#include "menu.h"
+
+static TWindow* win;
+
+typedef struct menu_case {
+    int n;
+    ttk_menu_item* items;  // n entries + terminator
+    ttk_menu_item* shuffled;  // the same, out of order
+    char* names;
+} menu_case;
+
+static void make_items(menu_case* c) {
+    static char* genres[] = {"Rock", "Jazz", "Pop", "Folk", "Blues",
+                             "Soul", "Metal", "Punk", "Reggae", "Classical"};
+    int i;
+    char* p;
+
+    c->items = calloc(c->n + 1, sizeof(ttk_menu_item));
+    c->names = p = malloc(c->n * 64);
+    for (i = 0; i < c->n; i++) {
+        // every seventh name is too long for the row and gets truncated
+        if (i % 7 == 3)
+            sprintf(p, "Track %06d - An Unreasonably Long Song Title", i);
+        else
+            sprintf(p, "Track %06d", i);
+        c->items[i].name = p;
+        if (i % 5 == 0) c->items[i].flags = TTK_MENU_ICON_SUB;
+        c->items[i].group_name = genres[i % 10];
+        p += strlen(p) + 1;
+    }
+
+    c->shuffled = malloc((c->n + 1) * sizeof(ttk_menu_item));
+    memcpy(c->shuffled, c->items, (c->n + 1) * sizeof(ttk_menu_item));
+    srand(1);
+    for (i = c->n - 1; i > 0; i--) {
+        ttk_menu_item t = c->shuffled[i];
+        int j = rand() % (i + 1);
+        c->shuffled[i] = c->shuffled[j];
+        c->shuffled[j] = t;
+    }
+}
+
+static ttk_menu_list* new_list(menu_case* c, ttk_menu_item* items) {
+    ttk_menu_list* list = ttk_new_menu_list(0);
+    int i;
+
+    for (i = 0; i < c->n; i++)
+        ttk_menu_list_add(list, items[i].name, items[i].flags, 0);
+    return list;
+}
+
+static TWidget* new_menu(menu_case* c) {
+    return ttk_new_menu_widget(c->items, ttk_menufont, win->w, win->h);
+}
+
+static void bench_build(long n, void* arg) {
+    menu_case* c = arg;
+    while (n--) ttk_free_widget(new_menu(c));
+}
+
+static void bench_append(long n, void* arg) {
+    menu_case* c = arg;
+    TWidget* menu;
+    int i;
+
+    while (n--) {
+        // a menu created without items owns (and frees) what's appended
+        menu = ttk_new_menu_widget(0, ttk_menufont, win->w, win->h);
+        for (i = 0; i < c->n; i++) {
+            ttk_menu_item* item = calloc(1, sizeof(ttk_menu_item));
+            item->name = c->items[i].name;
+            item->flags = c->items[i].flags;
+            ttk_menu_append(menu, item);
+        }
+        ttk_free_widget(menu);
+    }
+}
+
+// All at once, as a screen being opened would: half the items appended,
+// then the other half inserted among them.
+static void bench_insert_items(long n, void* arg) {
+    menu_case* c = arg;
+    ttk_menu_item** items = malloc(c->n * sizeof(ttk_menu_item*));
+    TWidget* menu;
+    int i, half = c->n / 2;
+
+    while (n--) {
+        menu = ttk_new_menu_widget(0, ttk_menufont, win->w, win->h);
+        for (i = 0; i < c->n; i++) {
+            items[i] = calloc(1, sizeof(ttk_menu_item));
+            items[i]->name = c->items[i].name;
+            items[i]->flags = c->items[i].flags;
+        }
+        ttk_menu_append_items(menu, items, half);
+        ttk_menu_insert_items(menu, items + half, c->n - half, half / 2);
+        ttk_free_widget(menu);
+    }
+    free(items);
+}
+
+// The same items in a compact list, up to the first paint.
+static void bench_list_build(long n, void* arg) {
+    menu_case* c = arg;
+    TWidget* menu;
+
+    while (n--) {
+        menu = ttk_new_menu_widget_list(new_list(c, c->items), ttk_menufont,
+                                        win->w, win->h);
+        menu->draw(menu, win->srf);
+        ttk_free_widget(menu);
+    }
+}
+
+static void bench_sort(long n, void* arg) {
+    menu_case* c = arg;
+    TWidget* menu;
+
+    while (n--) {
+        bench_pause();
+        menu = ttk_new_menu_widget(c->shuffled, ttk_menufont, win->w, win->h);
+        bench_resume();
+        ttk_menu_sort(menu);
+        bench_pause();
+        ttk_free_widget(menu);
+        bench_resume();
+    }
+}
+
+// Sorting into genres, each given a header.
+static void bench_sort_groups(long n, void* arg) {
+    menu_case* c = arg;
+    ttk_menu_item** items = malloc(c->n * sizeof(ttk_menu_item*));
+    TWidget* menu;
+    int i;
+
+    while (n--) {
+        bench_pause();
+        menu = ttk_new_menu_widget(0, ttk_menufont, win->w, win->h);
+        for (i = 0; i < c->n; i++) {
+            items[i] = calloc(1, sizeof(ttk_menu_item));
+            *items[i] = c->shuffled[i];
+        }
+        ttk_menu_append_items(menu, items, c->n);
+        bench_resume();
+        ttk_menu_sort_groups(menu);
+        bench_pause();
+        ttk_free_widget(menu);
+        bench_resume();
+    }
+    free(items);
+}
+
+static void bench_list_sort(long n, void* arg) {
+    menu_case* c = arg;
+    ttk_menu_list* list;
+
+    while (n--) {
+        bench_pause();
+        list = new_list(c, c->shuffled);
+        bench_resume();
+        ttk_menu_list_sort(list);
+        bench_pause();
+        ttk_free_menu_list(list);
+        bench_resume();
+    }
+}
+
+// Looking items up by name, and jumping to a prefix, in a built menu;
+// the first call of each builds the name index.
+static void bench_find(long n, void* arg) {
+    menu_case* c = arg;
+    TWidget* menu;
+    volatile ttk_menu_item* item;
+    long i;
+
+    bench_pause();
+    menu = new_menu(c);
+    bench_resume();
+    for (i = 0; i < n; i++)
+        item = ttk_menu_get_item_called(menu, c->items[i * 7919 % c->n].name);
+    bench_pause();
+    ttk_free_widget(menu);
+    bench_resume();
+}
+
+static void bench_jump(long n, void* arg) {
+    menu_case* c = arg;
+    TWidget* menu;
+    char prefix[16];
+    long i;
+
+    bench_pause();
+    menu = new_menu(c);
+    bench_resume();
+    for (i = 0; i < n; i++) {
+        sprintf(prefix, "track %03ld", i * 7919 % (c->n / 1000));
+        ttk_menu_jump(menu, prefix);
+    }
+    bench_pause();
+    ttk_free_widget(menu);
+    bench_resume();
+}
+
+static void bench_idle(long n, void* arg) {
+    TWidget* menu;
+
+    bench_pause();
+    menu = new_menu(arg);
+    bench_resume();
+    while (n--) {
+        menu->frame(menu);
+        menu->draw(menu, win->srf);
+    }
+    bench_pause();
+    ttk_free_widget(menu);
+    bench_resume();
+}
+
+// One wheel event and the redraw it causes, sweeping the whole list back
+// and forth; wheel acceleration kicks in as it would on a fast spin. A
+// smooth menu also glides for a 60 fps frame's worth each time.
+static void scroll_menu(long n, TWidget* menu, int smooth) {
+    int dir = 1;
+
+    ttk_menu_set_smooth(menu, smooth);
+    menu->draw(menu, win->srf);
+    bench_resume();
+    while (n--) {
+        if (!menu->scroll(menu, dir)) dir = -dir;
+        ttk_menu_glide(menu, 16);
+        menu->draw(menu, win->srf);
+    }
+    bench_pause();
+    ttk_free_widget(menu);
+    bench_resume();
+}
+
+static void bench_scroll(long n, void* arg) {
+    bench_pause();
+    scroll_menu(n, new_menu(arg), 0);
+}
+
+static void bench_scroll_smooth(long n, void* arg) {
+    bench_pause();
+    scroll_menu(n, new_menu(arg), 1);
+}
+
+static void bench_list_scroll(long n, void* arg) {
+    menu_case* c = arg;
+
+    bench_pause();
+    scroll_menu(n,
+                ttk_new_menu_widget_list(new_list(c, c->items), ttk_menufont,
+                                         win->w, win->h),
+                0);
+}
+
+int main(int argc, char** argv) {
+    static int sizes[] = {10000, 30000, 100000};
+    menu_case cases[3];
+    char name[64];
+    int i;
+
+    win = bench_init(argc, argv, "schemes/mono.cs");
+
+    for (i = 0; i < 3; i++) {
+        cases[i].n = sizes[i];
+        make_items(&cases[i]);
+    }
+
+    for (i = 0; i < 3; i++) {
+        sprintf(name, "menu_build/%d", sizes[i]);
+        bench_run(name, bench_build, &cases[i]);
+        sprintf(name, "menu_append/%d", sizes[i]);
+        bench_run(name, bench_append, &cases[i]);
+        sprintf(name, "menu_insert_items/%d", sizes[i]);
+        bench_run(name, bench_insert_items, &cases[i]);
+        sprintf(name, "menu_idle/%d", sizes[i]);
+        bench_run(name, bench_idle, &cases[i]);
+        sprintf(name, "menu_scroll/%d", sizes[i]);
+        bench_run(name, bench_scroll, &cases[i]);
+        sprintf(name, "menu_scroll_smooth/%d", sizes[i]);
+        bench_run(name, bench_scroll_smooth, &cases[i]);
+        sprintf(name, "menu_find/%d", sizes[i]);
+        bench_run(name, bench_find, &cases[i]);
+        sprintf(name, "menu_jump/%d", sizes[i]);
+        bench_run(name, bench_jump, &cases[i]);
+        sprintf(name, "menu_sort/%d", sizes[i]);
+        bench_run(name, bench_sort, &cases[i]);
+        sprintf(name, "menu_sort_groups/%d", sizes[i]);
+        bench_run(name, bench_sort_groups, &cases[i]);
+        sprintf(name, "menu_list_build/%d", sizes[i]);
+        bench_run(name, bench_list_build, &cases[i]);
+        sprintf(name, "menu_list_scroll/%d", sizes[i]);
+        bench_run(name, bench_list_scroll, &cases[i]);
+        sprintf(name, "menu_list_sort/%d", sizes[i]);
+        bench_run(name, bench_list_sort, &cases[i]);
+    }
+
+    for (i = 0; i < 3; i++) {
+        free(cases[i].items);
+        free(cases[i].shuffled);
+        free(cases[i].names);
+    }
+    ttk_quit();
+    return 0;
+}
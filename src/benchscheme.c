@@ -0,0 +1,91 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Loading .cs colour schemes, and looking properties up in them.
+
+#include "bench.h"
+
+// From the compiled copy the first load leaves beside the scheme...
+static void bench_load(long n, void* arg) {
+    while (n--) ttk_ap_load(arg);
+}
+
+// ...and parsed afresh, writing that copy each time.
+static void bench_load_cold(long n, void* arg) {
+    char cache[64];
+
+    sprintf(cache, "%sc", (char*)arg);
+    while (n--) {
+        bench_pause();
+        remove(cache);
+        bench_resume();
+        ttk_ap_load(arg);
+    }
+}
+
+static const char* props[] = {"window.bg", "window.fg",  "header.bg",
+                              "header.fg", "header.line", "menu.bg",
+                              "menu.fg",   "menu.selbg", "menu.selfg",
+                              "scroll.bar"};
+
+static void bench_get(long n, void* arg) {
+    int i = 0;
+    volatile TApItem* ap;
+
+    bench_pause();
+    ttk_ap_load(arg);
+    bench_resume();
+    while (n--) ap = ttk_ap_get(props[i++ % 10]);
+}
+
+// The same properties by interned handle, as the drawing code does.
+static void bench_lookup(long n, void* arg) {
+    static int handles[10];
+    int i = 0;
+    volatile TApItem* ap;
+
+    bench_pause();
+    for (i = 0; i < 10; i++) handles[i] = ttk_ap_intern(props[i]);
+    ttk_ap_load(arg);
+    bench_resume();
+    while (n--) ap = ttk_ap_lookup(handles[i++ % 10]);
+}
+
+int main(int argc, char** argv) {
+    // small, large, and one that loads images
+    static const char* schemes[] = {"mono", "lilac", "familiar"};
+    char name[64], file[64];
+    int i;
+
+    bench_init(argc, argv, 0);
+
+    for (i = 0; i < 3; i++) {
+        sprintf(file, "schemes/%s.cs", schemes[i]);
+        sprintf(name, "scheme_load_cold/%s", schemes[i]);
+        bench_run(name, bench_load_cold, file);
+        sprintf(name, "scheme_load/%s", schemes[i]);
+        bench_run(name, bench_load, file);
+        sprintf(name, "ap_get/%s", schemes[i]);
+        bench_run(name, bench_get, file);
+        sprintf(name, "ap_lookup/%s", schemes[i]);
+        bench_run(name, bench_lookup, file);
+    }
+
+    ttk_quit();
+    return 0;
+}
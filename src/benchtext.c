@@ -0,0 +1,127 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Text drawing, measuring and fitting for each kind of font, and textarea
+// wrapping.
+
+#include "bench.h"
+#include "textarea.h"
+
+extern ttk_screeninfo* ttk_screen;
+static TWindow* win;
+
+static const char line[] = "The quick brown fox jumps over the lazy dog";
+static const char line_utf8[] = "Bj\xc3\xb6rk \xe2\x80\x93 J\xc3\xb3ga (Caf\xc3\xa9 Mix)";
+
+static void bench_draw(long n, void* arg) {
+    ttk_font f = arg;
+    while (n--) ttk_text(win->srf, f, 2, 2, ttk_makecol(BLACK), line);
+}
+static void bench_draw_utf8(long n, void* arg) {
+    ttk_font f = arg;
+    while (n--) ttk_text(win->srf, f, 2, 2, ttk_makecol(BLACK), line_utf8);
+}
+static void bench_width(long n, void* arg) {
+    ttk_font f = arg;
+    volatile int w;
+    while (n--) w = ttk_text_width(f, line);
+}
+
+typedef struct fit_case {
+    ttk_font f;
+    int mode;
+} fit_case;
+
+// The line into two thirds of its width, as a long menu item would be.
+static void bench_fit(long n, void* arg) {
+    fit_case* c = arg;
+    int width = ttk_text_width(c->f, line) * 2 / 3;
+    volatile int w;
+    ttk_fit fit;
+
+    while (n--) {
+        ttk_text_fit(c->f, line, width, c->mode, &fit);
+        w = fit.width;
+    }
+}
+
+static char* lorem(int size) {
+    static const char* words[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet,", "consectetur",
+        "adipisicing", "elit,", "sed", "do", "eiusmod", "tempor",
+        "incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua."};
+    char* ret = malloc(size + 32);
+    int len = 0, i = 0;
+
+    while (len < size) {
+        len += sprintf(ret + len, "%s%s", words[i % 19],
+                       (i % 41 == 40) ? "\n\n" : " ");
+        i++;
+    }
+    return ret;
+}
+
+static void bench_wrap(long n, void* arg) {
+    while (n--)
+        ttk_free_widget(ttk_new_textarea_widget(win->w, win->h, arg,
+                                                ttk_textfont, 12));
+}
+
+int main(int argc, char** argv) {
+    // one of each kind shipped in fonts/; .png fonts need >2bpp
+    static const char* fonts[][2] = {{"Chicago", "fnt"},
+                                     {"Unifont", "fnt"},
+                                     {"Fixed 6x13", "fff"},
+                                     {"Aiken", "png"}};
+    static const char* modes[] = {"end", "middle", "word"};
+    static int sizes[] = {1024, 16384};
+    char name[64];
+    fit_case fc;
+    int i;
+
+    win = bench_init(argc, argv, "schemes/mono.cs");
+
+    for (i = 0; i < 4; i++) {
+        ttk_font f;
+
+        if (!strcmp(fonts[i][1], "png") && ttk_screen->bpp == 2) continue;
+        f = ttk_get_font(fonts[i][0], 12);
+        sprintf(name, "text_draw/%s/%s", fonts[i][1], fonts[i][0]);
+        bench_run(name, bench_draw, f);
+        sprintf(name, "text_draw_utf8/%s/%s", fonts[i][1], fonts[i][0]);
+        bench_run(name, bench_draw_utf8, f);
+        sprintf(name, "text_width/%s/%s", fonts[i][1], fonts[i][0]);
+        bench_run(name, bench_width, f);
+        for (fc.f = f, fc.mode = 0; fc.mode < 3; fc.mode++) {
+            sprintf(name, "text_fit/%s/%s/%s", modes[fc.mode], fonts[i][1],
+                    fonts[i][0]);
+            bench_run(name, bench_fit, &fc);
+        }
+        ttk_done_font(f);
+    }
+
+    for (i = 0; i < 2; i++) {
+        char* text = lorem(sizes[i]);
+        sprintf(name, "textarea_wrap/%d", sizes[i]);
+        bench_run(name, bench_wrap, text);
+        free(text);
+    }
+
+    ttk_quit();
+    return 0;
+}
@@ -42,11 +42,29 @@ static int ikbfd;
 extern ttk_screeninfo* ttk_screen;
 hd_engine* ttk_engine;
 
+// Part of the screen the next render needs to reach; no limit unless
+// ttk_gfx_update_rects() sets one.
+static int clip_x, clip_y, clip_w = -1, clip_h;
+
+static int clip_update(int* x, int* y, int* w, int* h) {
+    int x2 = *x + *w, y2 = *y + *h;
+
+    if (clip_w >= 0) {
+        *x = MAX(*x, clip_x);
+        *y = MAX(*y, clip_y);
+        x2 = MIN(x2, clip_x + clip_w);
+        y2 = MIN(y2, clip_y + clip_h);
+    }
+    *w = x2 - *x;
+    *h = y2 - *y;
+    return (*w > 0 && *h > 0);
+}
+
 #ifdef IPOD
 
 // Update the LCD.
 static void update(hd_engine* e, int x, int y, int w, int h) {
-    HD_LCD_Update(framebuffer, 0, 0, ttk_screen->w, ttk_screen->h);
+    if (clip_update(&x, &y, &w, &h)) HD_LCD_Update(framebuffer, x, y, w, h);
 }
 
 static struct termios stored_settings;
@@ -77,6 +95,8 @@ static void update2(hd_engine* e, int x, int y, int w,
                               /* Dk.Grey */ 0x528A,
                               /* Black   */ 0x0000};
 
+    if (!clip_update(&x, &y, &w, &h)) return;
+
     SDL_LockSurface(SDLscreen);
 
     int fbpitch = (ttk_screen->w + 3) / 4;
@@ -104,7 +124,7 @@ static void update2(hd_engine* e, int x, int y, int w,
 
 // Update the screen from a 16bpp framebuffer.
 static void update16(hd_engine* e, int x, int y, int w, int h) {
-    SDL_UpdateRect(SDLscreen, x, y, w, h);
+    if (clip_update(&x, &y, &w, &h)) SDL_UpdateRect(SDLscreen, x, y, w, h);
 }
 
 #endif
@@ -166,6 +186,27 @@ void ttk_gfx_quit() {
 
 void ttk_gfx_update(ttk_surface srf) { HD_Render(ttk_engine); }
 
+void ttk_gfx_update_rects(ttk_surface srf, int n, TRect* rects) {
+    int x1 = ttk_screen->w, y1 = ttk_screen->h, x2 = 0, y2 = 0;
+    int i;
+
+    // The engine renders in one pass, so hand it the bounding box.
+    for (i = 0; i < n; i++) {
+        x1 = MIN(x1, rects[i].x);
+        y1 = MIN(y1, rects[i].y);
+        x2 = MAX(x2, rects[i].x + rects[i].w);
+        y2 = MAX(y2, rects[i].y + rects[i].h);
+    }
+    if (x2 <= x1 || y2 <= y1) return;
+
+    clip_x = x1;
+    clip_y = y1;
+    clip_w = x2 - x1;
+    clip_h = y2 - y1;
+    HD_Render(ttk_engine);
+    clip_w = -1;
+}
+
 //////////////// Events ///////////////////
 
 #ifdef IPOD
@@ -196,10 +237,21 @@ void ttk_gfx_update(ttk_surface srf) { HD_Render(ttk_engine); }
 #define TOUCH_MASK 0x007f
 #define LIFT_MASK 0x007f
 
+// IKB can report multiple button events at once, we only want one at a
+// time, so save the rest.
+static int pending_presses, pending_releases;
+
+int ttk_gfx_wait_event(int ms) {
+    struct pollfd pfd;
+
+    if (pending_presses || pending_releases) return 1;
+
+    pfd.fd = ikbfd;
+    pfd.events = POLLIN;
+    return poll(&pfd, 1, ms) > 0;
+}
+
 int ttk_get_event(int* arg) {
-    // IKB can report multiple button events at once, we only want one at a
-    // time, so save the rest.
-    static int pending_presses, pending_releases;
     if (pending_presses || pending_releases) {
     handle_button:;  // Control is transferred here after receiving a button
                      // event, too.
@@ -295,13 +347,32 @@ int ttk_get_rawevent(int* arg) {
     return TTK_NO_EVENT;
 }
 
+int ttk_gfx_wait_event(int ms) {
+    SDL_Event ev;
+    Uint32 until = SDL_GetTicks() + ms;
+    int left;
+
+    while (1) {
+        SDL_PumpEvents();
+        if (SDL_PeepEvents(&ev, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) > 0) return 1;
+        if (ms < 0) {
+            SDL_Delay(10);
+            continue;
+        }
+        left = (int)(until - SDL_GetTicks());
+        if (left <= 0) return 0;
+        SDL_Delay(MIN(left, 10));
+    }
+}
+
 int ttk_get_event(int* arg) {
     SDL_Event ev;
     int tev = TTK_NO_EVENT;
 
     *arg = 0;
 
-    // We amalgamate adjacent scroll events to reduce lag.
+    // Scroll events are passed on one at a time; ttk_run() merges them if
+    // it falls behind.
     while (SDL_PollEvent(&ev)) {
         switch (ev.type) {
             case SDL_QUIT:
@@ -313,12 +384,8 @@ int ttk_get_event(int* arg) {
                 if (ev.key.keysym.sym == SDLK_l ||
                     ev.key.keysym.sym == SDLK_r) {
                     if (ev.type == SDL_KEYUP) continue;
-                    tev = TTK_SCROLL;
-                    if (ev.key.keysym.sym == SDLK_l)
-                        (*arg)--;
-                    else
-                        (*arg)++;
-                    break;
+                    *arg = (ev.key.keysym.sym == SDLK_r) ? 1 : -1;
+                    return TTK_SCROLL;
                 }
 
                 tev =
@@ -369,7 +436,7 @@ int ttk_get_event(int* arg) {
 }
 #endif
 
-int ttk_getticks() {
+int ttk_gfx_getticks() {
 #ifdef IPOD
     static int ipod_rtc = 0;
     if (!ipod_rtc) {
@@ -384,7 +451,7 @@ int ttk_getticks() {
 #endif
 }
 
-void ttk_delay(int ms) {
+void ttk_gfx_delay(int ms) {
     poll(0, 0, ms);  // nice, blocking, yielding delay for `ms' msec.
 }
 
@@ -768,6 +835,9 @@ void ttk_surface_get_dimen(ttk_surface srf, int* w, int* h) {
     *h = HD_SRF_HEIGHT(srf);
 }
 
+// hotdog blends on alpha and has no color key
+void ttk_surface_set_opaque(ttk_surface srf) {}
+
 void ttk_free_surface(ttk_surface srf) { HD_FreeSurface(srf); }
 
 void ttk_load_font(ttk_fontinfo* fi, const char* fnbase, int size) {
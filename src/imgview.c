@@ -183,7 +183,7 @@ static void do_dither(SDL_Surface* src, SDL_Surface* dst) {
 }
 #endif
 
-static ttk_surface floyd_steinberg_dither(ttk_surface srfc) {
+ttk_surface ttk_floyd_steinberg_dither(ttk_surface srfc) {
 #ifdef SDL /* Relatively high-speed SDL version */
 
     SDL_Surface *srf = SDL_CreateRGBSurface(0, srfc->w, srfc->h, 8, 0, 0, 0, 0),
@@ -292,6 +292,7 @@ TWidget* ttk_new_imgview_widget(int w, int h, ttk_surface img) {
     ret->data = data;
     ret->focusable = 1;
     ret->draw = ttk_imgview_draw;
+    ret->type = "imgview";
     ret->down = ttk_imgview_down;
     ret->scroll = ttk_imgview_scroll;
     ret->destroy = ttk_imgview_free;
@@ -318,7 +319,7 @@ TWidget* ttk_new_imgview_widget(int w, int h, ttk_surface img) {
         data->zoom = magH;
 
     data->cur = ttk_scale_surface(data->src, data->zoom);
-    if (ttk_screen->bpp == 2) data->cur = floyd_steinberg_dither(data->cur);
+    if (ttk_screen->bpp == 2) data->cur = ttk_floyd_steinberg_dither(data->cur);
 
     ttk_surface_get_dimen(data->cur, &data->cw, &data->ch);
 
@@ -409,7 +410,8 @@ int ttk_imgview_down(TWidget* this, int button) {
         ttk_free_surface(data->cur);
 
         data->cur = ttk_scale_surface(data->src, data->zoom);
-        if (ttk_screen->bpp <= 8) data->cur = floyd_steinberg_dither(data->cur);
+        if (ttk_screen->bpp <= 8)
+            data->cur = ttk_floyd_steinberg_dither(data->cur);
 
         ttk_surface_get_dimen(data->cur, &data->cw, &data->ch);
 
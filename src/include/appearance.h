@@ -59,11 +59,19 @@ typedef struct TApItem
     struct TApItem *next; // used in some cases
 } TApItem;
 
-void ttk_ap_load (const char *filename);
+void ttk_ap_load (const char *filename); /* caches a compiled copy as <filename>c */
+extern int ttk_ap_serial; /* bumped every time a scheme is loaded */
 
 TApItem *ttk_ap_get (const char *prop);  /* get a property, null if fail */
 TApItem *ttk_ap_getx (const char *prop); /* get a property, black if fail */
 
+/* For properties looked up on every draw: intern the name once (handles
+   are never 0, so a static 0 can mean "not interned yet"), then look it
+   up by handle. Handles stay valid across scheme loads. */
+int ttk_ap_intern (const char *prop);
+TApItem *ttk_ap_lookup (int h);          /* like ttk_ap_get  */
+TApItem *ttk_ap_lookupx (int h);         /* like ttk_ap_getx */
+
 /* get primary, fall back to secondary, fall back to def_color */
 /* returns a valid TApItem */
 TApItem *ttk_ap_getx_fb_dc(     const char *primary,
@@ -31,4 +31,7 @@ void ttk_imgview_free (TWidget *_this);
 TWindow *ttk_mh_imgview (struct ttk_menu_item *_this);
 void *ttk_md_imgview (ttk_surface srf);
 
+/* private: frees srf, returns it dithered to 2bpp (SDL only; others return srf) */
+ttk_surface ttk_floyd_steinberg_dither (ttk_surface srf);
+
 #endif
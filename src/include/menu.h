@@ -84,17 +84,53 @@ typedef struct ttk_menu_item
     /* readonly */ TWidget *menu;
     void *data2;
     void (*predraw)(struct ttk_menu_item *item);
+    /* private */ int hidden; // what visible() said when last asked
+    /* private */ int sortkey; const char *sortsrc; // collation key
+    /* private */ int subtop, subsel; // where sub was when it was freed
 } ttk_menu_item;
 
+// For lists too long to build up front: the menu asks for items as they
+// come onscreen, a page at a time, and forgets them again later.
+typedef struct ttk_menu_provider
+{
+    int (*count)(void *ctx); // how many items there are
+    // fill in out[0..n-1] with items first..first+n-1; out is zeroed first
+    void (*fetch)(void *ctx, int first, int n, ttk_menu_item *out);
+    // optional; called when the menu is done with items it fetched
+    void (*release)(void *ctx, int first, int n, ttk_menu_item *items);
+    void *ctx;
+    // optional; the first item whose name starts with prefix, or -1
+    int (*find)(void *ctx, const char *prefix);
+    // optional; the first item called exactly name, or -1
+    int (*lookup)(void *ctx, const char *name);
+} ttk_menu_provider;
+
+// Compact storage for long lists of plain items: a few bytes apiece in
+// dense arrays, with the names copied into one block. Items are made as
+// their rows are shown; cdata is set to the index ttk_menu_list_add() gave.
+typedef struct ttk_menu_list ttk_menu_list;
+
+ttk_menu_list *ttk_new_menu_list (TWindow *(*makesub)(ttk_menu_item *item));
+int ttk_menu_list_add (ttk_menu_list *list, const char *name, int flags, void *data);
+void ttk_menu_list_set_visible (ttk_menu_list *list, int i, int visible);
+void ttk_menu_list_sort (ttk_menu_list *list);
+void ttk_free_menu_list (ttk_menu_list *list); // not if a menu has it
+
 TWidget *ttk_new_menu_widget (ttk_menu_item *items, ttk_font font, int w, int h);
+TWidget *ttk_new_menu_widget_provider (ttk_menu_provider *prov, ttk_font font, int w, int h);
+TWidget *ttk_new_menu_widget_list (ttk_menu_list *list, ttk_font font, int w, int h); // frees list
 ttk_menu_item *ttk_menu_get_item (TWidget *_this, int i);
 ttk_menu_item *ttk_menu_get_item_called (TWidget *_this, const char *s);
 ttk_menu_item *ttk_menu_get_selected_item (TWidget *_this);
+int ttk_menu_jump (TWidget *_this, const char *prefix); // select the first item starting so
 void ttk_menu_remove_groups( TWidget *_this );
 void ttk_menu_set_closeable (TWidget *_this, int closeable);
 void ttk_menu_set_i18nable (TWidget *_this, int i18nable);
+void ttk_menu_set_smooth (TWidget *_this, int smooth);
+void ttk_menu_glide (TWidget *_this, int ms); // called by the frame handler
 void ttk_menu_sort (TWidget *_this);
 void ttk_menu_sort_groups (TWidget *_this);
+void ttk_menu_set_sort_articles (TWidget *_this, const char **articles);
 const char * ttk_filter_sorting_characters( const char * nam );
 
 void ttk_menu_sort_my_way (TWidget *_this, int (*cmp)(const void *, const void *));
@@ -102,6 +138,8 @@ void ttk_menu_sort_my_way_groups (TWidget *_this, int (*cmp)(const void *, const
 void ttk_menu_flash (ttk_menu_item *item, int nflashes);
 void ttk_menu_append (TWidget *_this, ttk_menu_item *item);
 void ttk_menu_insert (TWidget *_this, ttk_menu_item *item, int pos);
+void ttk_menu_append_items (TWidget *_this, ttk_menu_item **items, int n);
+void ttk_menu_insert_items (TWidget *_this, ttk_menu_item **items, int n, int pos);
 void ttk_menu_remove (TWidget *_this, int pos);
 void ttk_menu_remove_by_ptr (TWidget *_this, ttk_menu_item *item);
 void ttk_menu_remove_by_name (TWidget *_this, const char *name);
@@ -109,12 +147,21 @@ void ttk_menu_clear (TWidget *_this);
 void ttk_menu_item_updated (TWidget *, ttk_menu_item *); // call whenever you edit that item
 void ttk_menu_updated (TWidget *_this); // call whenever you edit the item list somehow;
                                        // FORGETS ABOUT ALL ADDED ITEMS!
+                                       // with a provider, asks count() again
+                                       // and refetches whatever is shown
+void ttk_menu_set_cache_size (int bytes); // for rendered rows of all menus; default 256k
+void ttk_menu_set_sub_cache_size (int bytes); // for submenus makesub made; default 512k
+// called before a cached submenu is freed to stay within that
+void ttk_menu_set_evict_hook (void (*hook)(ttk_menu_item *item, TWindow *sub));
+void ttk_menu_item_visibility_changed (TWidget *_this, ttk_menu_item *item); // visible() would now say otherwise
+void ttk_menu_visibility_changed (TWidget *_this); // asks every item's visible() again
 
 void ttk_menu_draw (TWidget *_this, ttk_surface srf);
 int ttk_menu_scroll (TWidget *_this, int dir);
 int ttk_menu_down (TWidget *_this, int button);
 int ttk_menu_button (TWidget *_this, int button, int time);
 int ttk_menu_frame (TWidget *_this);
+int ttk_menu_input (TWidget *_this, int ch); // type-ahead, see ttk_menu_jump
 void ttk_menu_free (TWidget *_this); // You don't need to call this, just call ttk_free_widget()
 
 TWindow *ttk_mh_sub (struct ttk_menu_item *item);
@@ -57,6 +57,8 @@
 #define TTK_FILTHY           15
 extern int ttk_dirty;
 
+typedef struct TRect { int x, y, w, h; } TRect;
+
 #define TTK_INPUT_ENTER  '\r'
 #define TTK_INPUT_BKSP   '\b'
 #define TTK_INPUT_LEFT   '\1'
@@ -69,13 +71,18 @@ struct TWidgetList;
 
 #define TTK_NO_BACKGROUND -1
 
-typedef struct _ttk_timer
+/* private: an entry in one of the due-time heaps kept by TTK core */
+typedef struct ttk_heapent
 {
-    int started;
-    int delay;
-    void (*fn)();
-    struct _ttk_timer *next;
-} *ttk_timer;
+    int due;
+    int slot; /* index in the heap, or -1 if not queued */
+    void *owner;
+} ttk_heapent;
+
+/* A ttk_timer is an opaque handle: use ttk_timer_get_*() to look at the
+   timer. Once it fires or is destroyed it no longer names anything, and 0
+   never names a timer. */
+typedef unsigned long long ttk_timer;
 
 typedef unsigned short uc16;
 #ifdef SDL
@@ -133,6 +140,30 @@ typedef struct _ttk_font
     int ofs;
     struct ttk_fontinfo *fi;
 } * ttk_font;
+#elif defined(NULLGFX)
+/* Headless: surfaces are plain memory, colors are in the surface's format
+ * (a 0-3 grey level at 2bpp, RGB565 at 16bpp, XRGB8888 at 32bpp). */
+typedef unsigned int ttk_color;
+typedef struct _ttk_surface {
+    int w, h, bpp;
+    int pitch;              /* bytes per row */
+    unsigned char *pixels;  /* 1 byte per pixel at 2bpp */
+    int keyed;              /* blits skip pixels equal to key */
+    ttk_color key;
+} *ttk_surface;
+typedef struct ttk_point { int x, y; } ttk_point;
+typedef struct _ttk_font
+{
+    int height;
+    int ofs;
+    struct ttk_fontinfo *fi;
+} * ttk_font;
+typedef struct _ttk_gc
+{
+    ttk_color fg, bg;
+    int usebg, xormode;
+    ttk_font font;
+} *ttk_gc;
 #else /* Hotdog */
 #include "hotdog.h"
 typedef uint32 ttk_color;
@@ -158,6 +189,8 @@ typedef struct TWidgetList
 } TWidgetList;
 
 struct TApItem;
+struct ttk_heap;
+struct ttk_bgcache;
 
 typedef struct TWindow
 {
@@ -172,11 +205,11 @@ typedef struct TWindow
     /* private */ struct TWidget *input;
     /* private */ int show_header;
     /* private */ int epoch;
-    /* private */ int inbuf[32]; // circular buffer
-    /* private */ int inbuf_start, inbuf_end;
     /* private */ int onscreen;
     int data;
     void *data2;
+    /* private */ struct ttk_heap *sched; // widgets waiting on frame/timer
+    /* private */ struct ttk_bgcache *bgcache; // rendered window background
 } TWindow;
 
 typedef struct TWindowStack {
@@ -216,6 +249,11 @@ typedef struct TWidget
 
     void *data;
     void *data2;
+
+    /* private */ ttk_heapent sched;
+    /* private */ struct ttk_heap *schedheap; // which scheduler sched is on
+    /* private */ int framefps, framerem, frameacc; // 1000/fps remainder
+    const char *type; // static string naming the kind of widget, for traces
 } TWidget;
 
 typedef struct ttk_fontinfo {
@@ -228,6 +266,7 @@ typedef struct ttk_fontinfo {
     int offset;
     int refs;
     struct ttk_fontinfo *next;
+    short *adv;      /* private: ASCII advances, for ttk_text_fit() */
 } ttk_fontinfo;
 
 typedef struct ttk_screeninfo {
@@ -290,6 +329,8 @@ void ttk_widget_set_timer (TWidget *wid, int ms);
 void ttk_add_header_widget (TWidget *wid);
 void ttk_remove_header_widget (TWidget *wid);
 
+void ttk_damage (int x, int y, int w, int h); // screen area to present next frame
+
 void ttk_set_global_event_handler (int (*fn)(int, int, int));
 void ttk_set_global_unused_handler (int (*fn)(int, int, int));
 int ttk_button_pressed (int button);
@@ -302,10 +343,42 @@ void ttk_wake_cop();
 
 ttk_timer ttk_create_timer (int ms, void (*fn)());
 void ttk_destroy_timer (ttk_timer tim);
+int ttk_timer_get_started (ttk_timer tim);
+int ttk_timer_get_delay (ttk_timer tim);
+void (*ttk_timer_get_fn (ttk_timer tim))();
 
 void ttk_set_transition_frames (int frames);
 void ttk_set_clicker (void (*fn)());
 void ttk_set_scroll_multiplier (int num, int denom);
+void ttk_set_scroll_budget (int ms);
+int ttk_event_overflows();
+int ttk_record_events (const char *file); /* 0 stops; ret=>0 ok, -1 can't open */
+int ttk_replay_events (const char *file, void (*done)()); /* ret=>0 ok, -1 bad log */
+
+// Where ttk_run() spends each frame, in microseconds; FRAME is the sum.
+enum {
+        TTK_STAT_TIMERS = 0,
+        TTK_STAT_EVENTS,
+        TTK_STAT_HEADER,
+        TTK_STAT_DRAW,
+        TTK_STAT_INPUT,
+        TTK_STAT_UPDATE,
+        TTK_STAT_FRAME,
+        TTK_STAT_PIXELS, // presented, not microseconds
+        TTK_NSTATS
+};
+typedef struct ttk_frame_stat {
+    int min, avg, p99, max, last;
+} ttk_frame_stat;
+void ttk_frame_stats_enable (int on);
+void ttk_frame_stats_reset();
+int ttk_frame_stats (int stat, ttk_frame_stat *st); /* ret=>frames sampled */
+TWidget *ttk_new_frame_stats_widget (int x, int y); // enables stats
+int ttk_trace_start (int events); /* ring size, 0=>16384; ret=>0 ok, -1 no mem */
+void ttk_trace_stop();
+int ttk_trace_dump (const char *file); /* Chrome trace_event JSON; -1 can't write */
+long long ttk_trace_begin(); /* 0 if not tracing */
+void ttk_trace_end (long long start, const char *name, const char *cat, const char *detail);
 
 int ttk_input_start_for (TWindow *win, TWidget *inmethod);
 void ttk_input_move_for (TWindow *win, int x, int y);
@@ -319,7 +392,7 @@ void ttk_input_end();
 
 // -- Implemented by GFX driver --
 
-#if !defined(SDL) && !defined(MWIN) /* Hotdog */
+#if !defined(SDL) && !defined(MWIN) && !defined(NULLGFX) /* Hotdog */
 #define TTK_ACOLOR(r,g,b,a) HD_RGBA(r,g,b,a)
 #define TTK_COLOR(r,g,b) HD_RGB(r,g,b)
 #else
@@ -373,7 +446,7 @@ void ttk_aapoly_gc (ttk_surface srf, ttk_gc gc, int n, ttk_point *v);
 void ttk_fillpoly (ttk_surface srf, int nv, short *vx, short *vy, ttk_color col);
 void ttk_fillpoly_pt (ttk_surface srf, ttk_point *v, int n, ttk_color col);
 void ttk_fillpoly_gc (ttk_surface srf, ttk_gc gc, int n, ttk_point *v);
-#if !defined(SDL) && !defined(MWIN) /* Hotdog */
+#if !defined(SDL) && !defined(MWIN) /* Hotdog, null */
 void ttk_polyline (ttk_surface srf, int nv, short *vx, short *vy, ttk_color col);
 void ttk_polyline_pt (ttk_surface srf, ttk_point *v, int n, ttk_color col);
 void ttk_polyline_gc (ttk_surface srf, ttk_gc gc, int n, ttk_point *v);
@@ -420,6 +493,19 @@ int ttk_text_width_gc (ttk_gc gc, const char *str);
 int ttk_text_height (ttk_font fnt);
 int ttk_text_height_gc (ttk_gc gc);
 
+/* Fitting text into a width, shortened with "..." if it won't go. */
+#define TTK_FIT_END	0 /* "A long ti..." */
+#define TTK_FIT_MIDDLE	1 /* "A lon...itle" */
+#define TTK_FIT_WORD	2 /* "A long..." */
+typedef struct ttk_fit {
+    int head;  /* bytes kept from the start */
+    int tail;  /* where what's kept of the end starts; strlen() if none */
+    int width; /* of the shortened string, "..." and all */
+} ttk_fit;
+int ttk_text_advance (ttk_font fnt, const char *str); /* of the first character */
+int ttk_text_fit (ttk_font fnt, const char *str, int width, int mode, ttk_fit *fit); /* 1 if shortened */
+void ttk_text_fitted (ttk_surface srf, ttk_font fnt, int x, int y, ttk_color col, const char *str, const ttk_fit *fit);
+
 ttk_surface ttk_load_image (const char *path);
 void ttk_free_image (ttk_surface img);
 void ttk_blit_image (ttk_surface src, ttk_surface dst, int dx, int dy);
@@ -429,6 +515,8 @@ void ttk_blit_image_ex (ttk_surface src, int sx, int sy, int sw, int sh,
 ttk_surface ttk_new_surface (int w, int h, int bpp);
 ttk_surface ttk_scale_surface (ttk_surface srf, float factor);
 void ttk_surface_get_dimen (ttk_surface srf, int *w, int *h);
+/* CKEY pixels in srf are copied like any other when it's blitted. */
+void ttk_surface_set_opaque (ttk_surface srf);
 void ttk_free_surface (ttk_surface srf);
 
 #ifdef IPOD
@@ -454,7 +542,7 @@ void ttk_free_surface (ttk_surface srf);
 #define   GREY   160, 160, 160
 #define DKGREY    80,  80,  80
 #define  BLACK     0,   0,   0
-#ifdef SDL
+#if defined(SDL) || defined(NULLGFX)
 #define   CKEY   255,   0, 255
 #elif defined(MWIN)
 #define   CKEY   255, 255, 255
@@ -501,12 +589,23 @@ do { 			\
 #define TTK_TOUCH        4
 #define TTK_LIFT         5
 #define TTK_TAP          6
+#define TTK_TEXT         7 /* only ever queued, by ttk_input_char(); arg=>char */
 
 void ttk_gfx_init();
 void ttk_gfx_update (ttk_surface srf);
+void ttk_gfx_update_rects (ttk_surface srf, int n, TRect *rects);
 void ttk_load_font (ttk_fontinfo *fi, const char *fname, int size);
 int ttk_get_event (int *arg); /* ret=>ev code, see above; arg=>button pressed */
 int ttk_get_rawevent (int *arg);
+int ttk_gfx_wait_event (int ms); /* sleep until input arrives or ms pass (<0 => forever); ret=>1 if input is pending */
+int ttk_gfx_getticks();
+void ttk_gfx_delay (int ms);
+#ifdef NULLGFX
+void ttk_null_stats (long *frames, long *pixels); /* presented so far */
+void ttk_null_dump_frames (const char *dir); /* PGM/PPM per present; 0 => stop */
+#endif
+/* These go through the record/replay clock; use them, not the ttk_gfx_ ones. */
+int ttk_wait_event (int ms);
 int ttk_getticks();
 void ttk_delay (int ms);
 
@@ -18,6 +18,7 @@
  * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,6 +34,9 @@ extern char* gettext(const char* msgid);
 #ifndef MIN
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #endif
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
 
 #define _MAKETHIS menu_data* data = (menu_data*)this->data
 
@@ -43,7 +47,6 @@ typedef struct _menu_data {
     int allocation;
     ttk_menu_item* mlist;
     int *vixi, *xivi, vitems;
-    ttk_surface *itemsrf, *itemsrfI;
     ttk_font font;
     int items, itemheight, top, sel, visible, scroll, spos, sheight;
     int ds;
@@ -52,6 +55,25 @@ typedef struct _menu_data {
     int free_everything;
     int i18nable;
     int drawn;
+    ttk_menu_provider prov;  // prov.fetch is set for menus paged in from one
+    struct menu_page* pages;
+    int pageclock;
+    int lastdir;  // which way top last moved
+    ttk_menu_list* list;  // freed with the menu
+    int *byname, bynamelen, bynamealloc;  // see forget_index()
+    int inorder;  // byname is in xi order too, i.e. the menu is sorted
+    ttk_menu_item** hash;
+    int hashsize;
+    char typed[32];  // for type-ahead
+    int typedat;
+    char* keys;  // collation keys, see sort_items()
+    int keyslen, keysalloc, keysdead;
+    const char** articles;
+    ttk_surface ring, linebuf;  // the rows on screen, see ring_check()
+    struct menu_slot* slots;
+    int nslots, ringw, ringh;
+    long long vpos;  // see ttk_menu_glide()
+    int vvel, smooth, moving, lastglide, ticked;
 } menu_data;
 
 // Note:
@@ -60,20 +82,139 @@ typedef struct _menu_data {
 // indexes in the imaginary "list" of *visible* items. ("Visible"
 // as in "[item]->visible() returns 1", not "onscreen right now".)
 
-static void MakeVIXI(TWidget* this) {
-    int vi, xi;
+// A menu with a provider only holds the items it has fetched lately, in
+// MENU_PAGES pages of MENU_PAGE items each; the rest of the list is never
+// looked at. Such menus have no hidden items, so vi == xi.
+#define MENU_PAGE 32
+#define MENU_PAGES 8
+
+typedef struct menu_page {
+    int first, n, used;  // first < 0 if empty
+    ttk_menu_item item[MENU_PAGE];
+} menu_page;
+
+#define XI(data, vi) ((data)->prov.fetch ? (vi) : (data)->xivi[vi])
+#define HAVE_ITEMS(data) \
+    ((data)->items && ((data)->menu || (data)->prov.fetch))
+
+static void forget_row(ttk_menu_item* item);
+static void forget_sub(ttk_menu_item* item);
+static int window_busy(TWindow* win);
+static void sub_orphan(ttk_menu_item* item);
+static void sub_reap(void);
+
+static void drop_page(TWidget* this, menu_page* pg) {
     _MAKETHIS;
+    int i;
 
-    for (vi = xi = 0; xi < data->items; xi++) {
+    if (pg->first < 0) return;
+    for (i = 0; i < pg->n; i++) {
+        ttk_menu_item* item = pg->item + i;
+        forget_row(item);
+        // Windows we made can be made again; one still up is freed once
+        // it's hidden.
+        if ((item->flags & TTK_MENU_MADESUB) && item->sub &&
+            !(item->sub < TTK_MENU_DESC_MAX)) {
+            if (window_busy(item->sub)) {
+                sub_orphan(item);
+                continue;
+            }
+            ttk_free_window(item->sub);
+        }
+        if (item->sub) forget_sub(item);
+    }
+    if (data->prov.release)
+        data->prov.release(data->prov.ctx, pg->first, pg->n, pg->item);
+    memset(pg, 0, sizeof(menu_page));
+    pg->first = -1;
+}
+
+static void drop_pages(TWidget* this) {
+    _MAKETHIS;
+    int i;
+
+    for (i = 0; i < MENU_PAGES; i++) drop_page(this, data->pages + i);
+}
+
+// The page holding row xi, fetching it over the least recently used one.
+static menu_page* page_for(TWidget* this, int xi) {
+    _MAKETHIS;
+    int first = xi - xi % MENU_PAGE, i;
+    menu_page *pg, *lru = data->pages;
+    long long t0;
+
+    for (i = 0, pg = data->pages; i < MENU_PAGES; i++, pg++) {
+        if (pg->first == first) {
+            pg->used = ++data->pageclock;
+            return pg;
+        }
+        if (pg->used < lru->used) lru = pg;
+    }
+
+    pg = lru;
+    drop_page(this, pg);
+    t0 = ttk_trace_begin();
+    pg->first = first;
+    pg->n = MIN(MENU_PAGE, data->items - first);
+    data->prov.fetch(data->prov.ctx, first, pg->n, pg->item);
+    for (i = 0; i < pg->n; i++) {
+        ttk_menu_item_updated(this, pg->item + i);
+        pg->item[i].menudata = data;
+    }
+    pg->used = ++data->pageclock;
+    ttk_trace_end(t0, "fetch", "menu", this->win ? this->win->title : 0);
+    return pg;
+}
+
+static ttk_menu_item* item_at(TWidget* this, int xi) {
+    _MAKETHIS;
+    menu_page* pg;
+
+    if (!data->prov.fetch) return data->menu[xi];
+    pg = page_for(this, xi);
+    return pg->item + (xi - pg->first);
+}
+
+// Rebuilds vixi/xivi from xi onwards out of each item's cached visibility;
+// no visible() callbacks are made.
+static void index_from(TWidget* this, int xi) {
+    _MAKETHIS;
+    int vi = xi ? data->vixi[xi - 1] + !data->menu[xi - 1]->hidden : 0;
+
+    for (; xi < data->items; xi++) {
         data->vixi[xi] = vi;
         data->xivi[vi] = xi;
-        if (!data->menu[xi]->visible || data->menu[xi]->visible(data->menu[xi]))
-            vi++;
+        if (!data->menu[xi]->hidden) vi++;
     }
     data->vitems = vi;
     data->scroll = (vi > data->visible);
 }
 
+// Asks item xi's visible() and caches the answer; returns 1 if it changed.
+static int check_visible(TWidget* this, int xi) {
+    _MAKETHIS;
+    ttk_menu_item* item = data->menu[xi];
+    long long t = ttk_trace_begin();
+    int hidden = item->visible && !item->visible(item);
+
+    // Only the slow ones, or a big menu would flood the trace.
+    if (t && ttk_trace_begin() - t >= 100)
+        ttk_trace_end(t, "visible", "menu", item->name);
+    if (hidden == item->hidden) return 0;
+    item->hidden = hidden;
+    return 1;
+}
+
+static void MakeVIXI(TWidget* this) {
+    int xi;
+    long long t0 = ttk_trace_begin();
+    _MAKETHIS;
+
+    for (xi = 0; xi < data->items; xi++) check_visible(this, xi);
+    index_from(this, 0);
+    ttk_trace_end(t0, "MakeVIXI", "menu", this->win ? this->win->title : 0);
+}
+
 /* some utility functions first... */
 
 /* this will clean strings that have sorting hints:
@@ -87,27 +228,143 @@ const char* ttk_filter_sorting_characters(const char* nam) {
     return (nam);
 }
 
-static void render(TWidget* this, int first, int n) {
-    int ih, vi, xi, ofs;
-    TApItem* ta;
-    ttk_color menu_bg_color = 0, menu_fg_color = 0;
-    ttk_color menu_selbg_color = 0, menu_selfg_color = 0;
-    ttk_color menu_hdrbg_color = 0, menu_hdrfg_color = 0;
-    _MAKETHIS;
-    int wid = this->w - 10 * data->scroll;
+// Rendered rows of all menus share one byte budget, and the rows drawn
+// least recently are freed to stay within it. A row is rendered when it's
+// first drawn, normal and selected separately, and again if it no longer
+// matches its item.
+typedef struct menu_row {
+    ttk_menu_item* item;
+    TWidget* menu;
+    const char* name;  // what it was rendered from
+    int width, height, header, epoch, serial;
+    ttk_surface srf[2];  // normal, selected
+    int stamp[2];        // different every time one is rendered
+    int bytes;
+    struct menu_row *prev, *next;  // most recently drawn first
+    struct menu_row* hnext;
+} menu_row;
+
+#define ROW_HASH 256
+#define ROW_BUCKET(item) (((unsigned long)(item) >> 4) % ROW_HASH)
+#define MENU_PREFETCH 4
+
+static menu_row* row_hash[ROW_HASH];
+static menu_row *row_mru, *row_lru;
+static int row_bytes, row_budget = 256 * 1024;
+static int row_stamp;
+
+static void row_unlink(menu_row* r) {
+    if (r->prev)
+        r->prev->next = r->next;
+    else
+        row_mru = r->next;
+    if (r->next)
+        r->next->prev = r->prev;
+    else
+        row_lru = r->prev;
+    r->prev = r->next = 0;
+}
 
-    if (!data->itemsrf)
-        data->itemsrf = calloc(data->allocation, sizeof(ttk_surface));
-    if (!data->itemsrfI)
-        data->itemsrfI = calloc(data->allocation, sizeof(ttk_surface));
+static void row_free_surfaces(menu_row* r) {
+    if (r->srf[0]) ttk_free_surface(r->srf[0]);
+    if (r->srf[1]) ttk_free_surface(r->srf[1]);
+    r->srf[0] = r->srf[1] = 0;
+    row_bytes -= r->bytes;
+    r->bytes = 0;
+}
 
-    ofs = (data->itemheight - ttk_text_height(data->font)) / 2;
+static void row_free(menu_row* r) {
+    menu_row** p = &row_hash[ROW_BUCKET(r->item)];
 
-    if (first >= data->items) {
-        return;
+    while (*p != r) p = &(*p)->hnext;
+    *p = r->hnext;
+    row_unlink(r);
+    row_free_surfaces(r);
+    free(r);
+}
+
+static menu_row* row_find(ttk_menu_item* item) {
+    menu_row* r;
+
+    for (r = row_hash[ROW_BUCKET(item)]; r; r = r->hnext)
+        if (r->item == item) return r;
+    return 0;
+}
+
+static void forget_row(ttk_menu_item* item) {
+    menu_row* r = row_find(item);
+    if (r) row_free(r);
+}
+
+static void forget_rows(TWidget* this) {
+    menu_row *r, *next;
+
+    for (r = row_mru; r; r = next) {
+        next = r->next;
+        if (r->menu == this) row_free(r);
     }
+}
+
+static void row_trim(menu_row* keep) {
+    while (row_bytes > row_budget && row_lru && row_lru != keep)
+        row_free(row_lru);
+}
+
+void ttk_menu_set_cache_size(int bytes) {
+    row_budget = bytes;
+    row_trim(0);
+}
+
+// Room for the name, after the scrollbar, icon and choice.
+static int line_width(TWidget* this, ttk_menu_item* item) {
+    _MAKETHIS;
+    int w = this->w - 10 * data->scroll - 4;
+
+    if (item->flags & TTK_MENU_ICON) w -= 12;
+    if (item->choices)
+        w -= ttk_text_width(data->font, item->choices[item->choice]) + 2;
+    return w;
+}
 
-    if (!data->menu) return;
+static int row_current(TWidget* this, menu_row* r, ttk_menu_item* item) {
+    _MAKETHIS;
+    return r->menu == this && r->name == item->name &&
+           r->epoch == ttk_epoch && r->serial == ttk_ap_serial &&
+           r->height == data->itemheight &&
+           r->header == !!(item->group_flags & TTK_MENU_GROUP_HEADER) &&
+           r->width == line_width(this, item);
+}
+
+// Properties looked up on every row drawn, by interned handle.
+enum {
+    AP_BG, AP_FG, AP_SELBG, AP_SELFG, AP_HDRBG, AP_HDRFG, AP_ICON,
+    AP_ICON0, AP_ICON1, AP_ICON2, AP_ICON3,  // iconflash 0-3, selected
+    AP_SCROLLBG, AP_SCROLLBOX, AP_SCROLLBAR, AP_LINE, AP_COUNT
+};
+
+static int ap_handle(int p) {
+    static const char* names[AP_COUNT] = {
+        "menu.bg",    "menu.fg",    "menu.selbg", "menu.selfg",
+        "menu.hdrbg", "menu.hdrfg", "menu.icon",  "menu.icon0",
+        "menu.icon1", "menu.icon2", "menu.icon3", "scroll.bg",
+        "scroll.box", "scroll.bar", "header.line"};
+    static int handle[AP_COUNT];
+
+    if (!handle[p]) handle[p] = ttk_ap_intern(names[p]);
+    return handle[p];
+}
+
+static TApItem* menu_ap(int p) { return ttk_ap_lookup(ap_handle(p)); }
+static TApItem* menu_apx(int p) { return ttk_ap_lookupx(ap_handle(p)); }
+
+// bg, fg, selbg, selfg, hdrbg, hdrfg for the loaded scheme
+static ttk_color* row_colors() {
+    static ttk_color col[6];
+    static int serial = -1;
+    TApItem* ta;
+
+    if (serial == ttk_ap_serial) return col;
+    serial = ttk_ap_serial;
 
     /* a little bit of insurance in case the menu colors loaded bad
      *
@@ -115,139 +372,377 @@ static void render(TWidget* this, int first, int n) {
      * and black.  If they are (Black box issue) then set them to be
      * something sane instead.
      */
-    menu_bg_color = ttk_ap_getx_color("menu.bg", ttk_makecol(WHITE));
-    menu_fg_color = ttk_ap_getx_color("menu.fg", ttk_makecol(BLACK));
-    menu_selbg_color = ttk_ap_getx_color("menu.selbg", ttk_makecol(BLACK));
-    menu_selfg_color = ttk_ap_getx_color("menu.selfg", ttk_makecol(WHITE));
-    menu_hdrbg_color =
-        ttk_ap_getx_color_fb("menu.hdrbg", "header.bg", ttk_makecol(GREY));
-    menu_hdrfg_color =
-        ttk_ap_getx_color_fb("menu.hdrfg", "header.fg", ttk_makecol(BLACK));
+    col[0] = ttk_ap_getx_color("menu.bg", ttk_makecol(WHITE));
+    col[1] = ttk_ap_getx_color("menu.fg", ttk_makecol(BLACK));
+    col[2] = ttk_ap_getx_color("menu.selbg", ttk_makecol(BLACK));
+    col[3] = ttk_ap_getx_color("menu.selfg", ttk_makecol(WHITE));
+    col[4] = ttk_ap_getx_color_fb("menu.hdrbg", "header.bg", ttk_makecol(GREY));
+    col[5] = ttk_ap_getx_color_fb("menu.hdrfg", "header.fg", ttk_makecol(BLACK));
 
     /* avoid black boxes based on bad colors -- only check if they're solid bg
      */
     /* these aren't pretty, but they're functional */
     ta = ttk_ap_getx("menu.bg");
-    if (!(ta->type & TTK_AP_GRADIENT) && (menu_bg_color == menu_fg_color))
-        menu_fg_color = ~menu_fg_color;
+    if (!(ta->type & TTK_AP_GRADIENT) && (col[0] == col[1])) col[1] = ~col[1];
 
     ta = ttk_ap_getx("menu.selbg");
-    if (!(ta->type & TTK_AP_GRADIENT) && (menu_selbg_color == menu_selfg_color))
-        menu_selfg_color = ~menu_selfg_color;
+    if (!(ta->type & TTK_AP_GRADIENT) && (col[2] == col[3])) col[3] = ~col[3];
 
     ta = ttk_ap_getx("menu.hdrbg");
-    if (!(ta->type & TTK_AP_GRADIENT) && (menu_hdrbg_color == menu_hdrfg_color))
-        menu_hdrfg_color = ~menu_hdrfg_color;
+    if (!(ta->type & TTK_AP_GRADIENT) && (col[4] == col[5])) col[5] = ~col[5];
+
+    return col;
+}
 
-    for (xi = 0, vi = data->vixi[0]; data->menu[xi] && vi < first + n;
-         xi++, vi = data->vixi[xi]) {
-        char* truncname;
+static void render(TWidget* this, menu_row* r, int sel) {
+    _MAKETHIS;
+    ttk_menu_item* item = r->item;
+    int ih = r->header, w = item->textwidth + 3;
+    int ofs = (data->itemheight - ttk_text_height(data->font)) / 2;
+    ttk_color* col = row_colors();
+    ttk_color bg = ih ? col[4] : sel ? col[2] : col[0];
+    ttk_color fg = ih ? col[5] : sel ? col[3] : col[1];
+    const char* name = ttk_filter_sorting_characters(
+        data->i18nable ? gettext(item->name) : item->name);
+    ttk_surface srf = ttk_new_surface(w, data->itemheight, ttk_screen->bpp);
+    TApItem* ta;
+    ttk_fit fit;
 
-        if (vi < first) continue;
+    if (sel)
+        ta = ttk_ap_getx_fb_dc(ih ? "menu.hdrbg" : "menu.selbg", "header.bg",
+                               ttk_makecol(WHITE));
+    else
+        ta = ttk_ap_getx(ih ? "menu.hdrbg" : "menu.bg");
+    if (ta->type & TTK_AP_GRADIENT && !(ta->type & TTK_AP_GRAD_HORIZ)) {
+        // ap surface
+        ttk_ap_rect(srf, ta, 0, 0, w + ta->rounding, data->itemheight);
+    } else {
+        // solid
+        ttk_fillrect(srf, 0, 0, w, data->itemheight, bg);
+    }
 
-        ih = data->menu[xi]->group_flags & TTK_MENU_GROUP_HEADER;
+    // the selected row scrolls instead of being shortened
+    if (!sel &&
+        ttk_text_fit(data->font, name, item->linewidth, TTK_FIT_END, &fit))
+        ttk_text_fitted(srf, data->font, 3, ofs, fg, name, &fit);
+    else
+        ttk_text(srf, data->font, 3, ofs, fg, name);
 
-        data->menu[xi]->linewidth = this->w - 10 * data->scroll;
-        if (data->menu[xi]->flags & TTK_MENU_ICON)
-            data->menu[xi]->linewidth -= 12;
-        if (data->menu[xi]->choices)
-            data->menu[xi]->linewidth -=
-                ttk_text_width(
-                    data->font,
-                    data->menu[xi]->choices[data->menu[xi]->choice]) +
-                2;
-        data->menu[xi]->linewidth -= 4;
+    r->srf[sel] = srf;
+    r->stamp[sel] = ++row_stamp;
+    r->bytes += (w * data->itemheight * ttk_screen->bpp + 7) / 8;
+    row_bytes += (w * data->itemheight * ttk_screen->bpp + 7) / 8;
+}
 
-        if ((data->menu[xi]->textwidth > data->menu[xi]->linewidth) &&
-            !(data->menu[xi]->flags & TTK_MENU_TEXT_SCROLLING))
-            data->menu[xi]->flags |= TTK_MENU_TEXT_SLEFT;
-        else if (data->menu[xi]->flags & TTK_MENU_TEXT_SCROLLING)
-            data->menu[xi]->flags &= ~TTK_MENU_TEXT_SCROLLING;
+// item's row as it should be drawn now, normal (sel = 0) or selected,
+// rendered if it isn't cached. *stamp, if asked for, changes whenever the
+// row is rendered again.
+static ttk_surface row_surface(TWidget* this, ttk_menu_item* item, int sel,
+                               int* stamp) {
+    _MAKETHIS;
+    menu_row* r = row_find(item);
 
-        /* setup the Unselected cache */
+    if (!r) {
+        r = calloc(1, sizeof(menu_row));
+        r->item = item;
+        r->hnext = row_hash[ROW_BUCKET(item)];
+        row_hash[ROW_BUCKET(item)] = r;
+    } else {
+        row_unlink(r);
+    }
+    r->next = row_mru;
+    if (row_mru) row_mru->prev = r;
+    row_mru = r;
+    if (!row_lru) row_lru = r;
+
+    if (!row_current(this, r, item)) {
+        // measured here rather than up front, so a new font or a long
+        // list costs nothing until rows are shown
+        row_free_surfaces(r);
+        r->menu = this;
+        r->name = item->name;
+        r->epoch = ttk_epoch;
+        r->serial = ttk_ap_serial;
+        r->height = data->itemheight;
+        r->header = !!(item->group_flags & TTK_MENU_GROUP_HEADER);
+        r->width = item->linewidth = line_width(this, item);
+        item->textwidth =
+            ttk_text_width(data->font,
+                           ttk_filter_sorting_characters(
+                               data->i18nable ? gettext(item->name)
+                                              : item->name)) +
+            4;
 
-        if (data->itemsrf[xi]) ttk_free_surface(data->itemsrf[xi]);
-        data->itemsrf[xi] = ttk_new_surface(data->menu[xi]->textwidth + 3,
-                                            data->itemheight, ttk_screen->bpp);
+        if ((item->textwidth > item->linewidth) &&
+            !(item->flags & TTK_MENU_TEXT_SCROLLING))
+            item->flags |= TTK_MENU_TEXT_SLEFT;
+        else if (item->flags & TTK_MENU_TEXT_SCROLLING)
+            item->flags &= ~TTK_MENU_TEXT_SCROLLING;
+    }
+    if (!r->srf[sel]) {
+        render(this, r, sel);
+        row_trim(r);
+    }
+    if (stamp) *stamp = r->stamp[sel];
+    return r->srf[sel];
+}
 
-        ta = ttk_ap_getx(ih ? "menu.hdrbg" : "menu.bg");
-        if (ta->type & TTK_AP_GRADIENT && !(ta->type & TTK_AP_GRAD_HORIZ)) {
-            // ap surface
-            ttk_ap_rect(data->itemsrf[xi], ta, 0, 0,
-                        data->menu[xi]->textwidth + 3 + ta->rounding,
-                        data->itemheight);
-        } else {
-            // solid
-            ttk_fillrect(data->itemsrf[xi], 0, 0, data->menu[xi]->textwidth + 3,
-                         data->itemheight,
-                         ih ? menu_hdrbg_color : menu_bg_color);
-        }
+// Between events, render the next few rows in the direction we've been
+// scrolling, so that moving onto them needn't.
+static void prefetch(TWidget* this) {
+    _MAKETHIS;
+    int k, vi, done = 0;
+
+    if (row_bytes > row_budget / 4 * 3) return;  // would push out rows shown
+    for (k = 0; k < MENU_PREFETCH && done < 2; k++) {
+        ttk_menu_item* item;
+        menu_row* r;
+
+        vi = (data->lastdir > 0) ? data->top + data->visible + k
+                                 : data->top - 1 - k;
+        if (vi < 0 || vi >= data->vitems) break;
+        item = item_at(this, XI(data, vi));
+        if ((r = row_find(item)) && r->srf[0] && row_current(this, r, item))
+            continue;
+        row_surface(this, item, 0, 0);
+        done++;
+    }
+}
 
-        if (data->i18nable)
-            truncname = strdup((const char*)ttk_filter_sorting_characters(
-                (gettext(data->menu[xi]->name))));
-        else
-            truncname = strdup((const char*)ttk_filter_sorting_characters(
-                data->menu[xi]->name));
-
-        if (ttk_text_width(data->font, truncname) > data->menu[xi]->linewidth) {
-            int len = strlen(truncname);
-            while (--len > 4) {
-                memcpy(truncname + len - 4, "...\0", 4);
-                if (ttk_text_width(data->font, truncname) <
-                    data->menu[xi]->linewidth)
-                    break;
-            }
-        }
+// Sorting and the name index compare collation keys made once per item:
+// the name shown, lowercased, less any leading article. They're kept in
+// one block per menu until the item is renamed or its translation
+// changes, so sorting again costs little more than the merge.
+static int article_length(menu_data* data, const char* s) {
+    const char** a;
+    int len;
+
+    if (!data->articles) return 0;
+    for (a = data->articles; *a; a++) {
+        len = strlen(*a);
+        // "The" alone sorts as itself
+        if (!strncasecmp(s, *a, len) && s[len]) return len;
+    }
+    return 0;
+}
 
-        ttk_text(data->itemsrf[xi], data->font, 3, ofs,
-                 ih ? menu_hdrfg_color : menu_fg_color, truncname);
-        free(truncname);
+// Appends the key for src to the block and returns its offset.
+static int add_key(char** block, int* len, int* alloc, const char* src,
+                   menu_data* articles) {
+    int need = strlen(src) + 1;
+    char* key;
 
-        /* setup the Selected cache */
+    while (*len + need > *alloc) {
+        *alloc = *alloc ? *alloc * 2 : 4096;
+        *block = realloc(*block, *alloc);
+    }
+    key = *block + *len;
 
-        if (data->itemsrfI[xi]) ttk_free_surface(data->itemsrfI[xi]);
-        data->itemsrfI[xi] = ttk_new_surface(data->menu[xi]->textwidth + 3,
-                                             data->itemheight, ttk_screen->bpp);
+    // sorting hints (see above) stay in front of the article
+    if (*src == '#' || *src == '~' || *src == '_') *key++ = *src++;
+    if (articles) src += article_length(articles, src);
+    while (*src) *key++ = tolower((unsigned char)*src++);
+    *key++ = 0;
 
-        // selected background
-        ta = ttk_ap_getx_fb_dc(ih ? "menu.hdrbg" : "menu.selbg", "header.bg",
-                               ttk_makecol(WHITE));
-        if (ta->type & TTK_AP_GRADIENT && !(ta->type & TTK_AP_GRAD_HORIZ)) {
-            // ap surface
-            ttk_ap_rect(data->itemsrfI[xi], ta, 0, 0,
-                        data->menu[xi]->textwidth + 3 + ta->rounding,
-                        data->itemheight);
+    need = *len;
+    *len = key - *block;
+    return need;
+}
+
+// Brings item's key up to date; one with no name has none.
+static void key_item(menu_data* data, ttk_menu_item* item) {
+    const char* src = item->name;
+
+    if (!src) return;
+    if (data->i18nable) src = gettext(src);
+    if (item->sortsrc != src) {
+        if (item->sortsrc) data->keysdead++;
+        item->sortkey = add_key(&data->keys, &data->keyslen, &data->keysalloc,
+                                src, data);
+        item->sortsrc = src;
+    }
+}
+
+// Name index, built when first needed: a hash of every named item for
+// ttk_menu_get_item_called(), and every xi sorted by collation key for
+// ttk_menu_jump(), so "The Who" is found under W when it sorts there.
+// Adding items keeps it up to date; anything that moves or renames items,
+// or changes the articles, throws it away.
+static const char* index_key(menu_data* data, ttk_menu_item* item) {
+    return ttk_filter_sorting_characters(data->keys + item->sortkey);
+}
+
+static unsigned int name_hash(const char* s) {
+    unsigned int h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+static void forget_index(menu_data* data) {
+    free(data->byname);
+    free(data->hash);
+    data->byname = 0;
+    data->hash = 0;
+}
+
+static void hash_add(menu_data* data, ttk_menu_item* item) {
+    unsigned int h = name_hash(item->name);
+
+    while (data->hash[h & (data->hashsize - 1)]) h++;
+    data->hash[h & (data->hashsize - 1)] = item;
+}
+
+static void build_hash(menu_data* data) {
+    int xi;
+
+    for (data->hashsize = 64; data->hashsize < data->items * 2;)
+        data->hashsize *= 2;
+    data->hash = calloc(data->hashsize, sizeof(ttk_menu_item*));
+    for (xi = 0; xi < data->items; xi++)
+        if (data->menu[xi]->name) hash_add(data, data->menu[xi]);
+}
+
+typedef struct name_ent {
+    const char* name;
+    int xi;
+} name_ent;
+
+static int name_ent_compare(const void* a, const void* b) {
+    return strcmp(((name_ent*)a)->name, ((name_ent*)b)->name);
+}
+
+static void build_byname(menu_data* data) {
+    name_ent* ent = malloc(data->items * sizeof(name_ent) + 1);
+    int xi, n = 0;
+
+    for (xi = 0; xi < data->items; xi++) key_item(data, data->menu[xi]);
+    // the block is done growing, so pointers into it hold from here
+    for (xi = 0; xi < data->items; xi++) {
+        if (!data->menu[xi]->name) continue;
+        ent[n].name = index_key(data, data->menu[xi]);
+        ent[n++].xi = xi;
+    }
+    qsort(ent, n, sizeof(name_ent), name_ent_compare);
+    data->bynamealloc = data->allocation;
+    data->byname = malloc(data->bynamealloc * sizeof(int));
+    data->inorder = 1;
+    for (xi = 0; xi < n; xi++) {
+        data->byname[xi] = ent[xi].xi;
+        if (xi && ent[xi].xi < ent[xi - 1].xi) data->inorder = 0;
+    }
+    data->bynamelen = n;
+    free(ent);
+}
+
+// Where in byname the first key not less than s is, or would go.
+static int byname_lower(menu_data* data, const char* s) {
+    int lo = 0, hi = data->bynamelen, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcmp(index_key(data, data->menu[data->byname[mid]]), s) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Item xi was just put in the menu, and everything from xi on moved up.
+static void index_insert(menu_data* data, int xi) {
+    ttk_menu_item* item = data->menu[xi];
+    int i, pos;
+
+    if (!item->name) return;
+    if (data->hash) {
+        if (data->items * 2 > data->hashsize) {
+            free(data->hash);
+            build_hash(data);
         } else {
-            // solid
-            ttk_fillrect(data->itemsrfI[xi], 0, 0,
-                         data->menu[xi]->textwidth + 3, data->itemheight,
-                         ih ? menu_hdrbg_color : menu_selbg_color);
+            hash_add(data, item);
         }
-        // selected text
-        if (data->i18nable)
-            ttk_text(
-                data->itemsrfI[xi], data->font, 3, ofs,
-                ih ? menu_hdrfg_color : menu_selfg_color,
-                ttk_filter_sorting_characters(gettext(data->menu[xi]->name)));
-        else
-            ttk_text(data->itemsrfI[xi], data->font, 3, ofs,
-                     ih ? menu_hdrfg_color : menu_selfg_color,
-                     ttk_filter_sorting_characters(data->menu[xi]->name));
+    }
+    if (data->byname) {
+        if (data->bynamelen >= data->bynamealloc) {
+            data->bynamealloc = data->bynamealloc * 2 + 16;
+            data->byname =
+                realloc(data->byname, data->bynamealloc * sizeof(int));
+        }
+        if (xi < data->items - 1)
+            for (i = 0; i < data->bynamelen; i++)
+                if (data->byname[i] >= xi) data->byname[i]++;
+        key_item(data, item);
+        pos = byname_lower(data, index_key(data, item));
+        memmove(data->byname + pos + 1, data->byname + pos,
+                (data->bynamelen - pos) * sizeof(int));
+        data->byname[pos] = xi;
+        data->bynamelen++;
+        if ((pos && data->byname[pos - 1] > xi) ||
+            (pos < data->bynamelen - 1 && data->byname[pos + 1] < xi))
+            data->inorder = 0;
     }
 }
 
+// The first item shown whose key starts with prefix's, ignoring case and
+// any article it starts with; -1 if there's none.
+static int find_prefix(TWidget* this, const char* prefix) {
+    _MAKETHIS;
+    char* key;
+    int len, i, best = -1;
+
+    if (data->prov.fetch)
+        return data->prov.find ? data->prov.find(data->prov.ctx, prefix) : -1;
+    if (!data->byname) build_byname(data);
+
+    prefix += article_length(data, prefix);
+    key = malloc(strlen(prefix) + 1);
+    for (len = 0; prefix[len]; len++)
+        key[len] = tolower((unsigned char)prefix[len]);
+    key[len] = 0;
+
+    // the matches are all together, starting where the prefix would go
+    for (i = byname_lower(data, key); i < data->bynamelen; i++) {
+        ttk_menu_item* item = data->menu[data->byname[i]];
+        int vi = data->vixi[data->byname[i]];
+
+        if (strncmp(index_key(data, item), key, len)) break;
+        if (item->hidden || (item->group_flags & TTK_MENU_GROUP_HEADER))
+            continue;
+        if (best < 0 || vi < best) best = vi;
+        if (data->inorder) break;  // no later match comes sooner
+    }
+    free(key);
+    return best;
+}
+
 ttk_menu_item* ttk_menu_get_item(TWidget* this, int xi) {
     _MAKETHIS;
-    if (xi > data->items) return 0;
-    if (data->menu) return data->menu[xi];
+    if (xi > data->items || (data->prov.fetch && xi == data->items)) return 0;
+    if (data->menu || data->prov.fetch) return item_at(this, xi);
     return data->mlist + xi;
 }
 
 ttk_menu_item* ttk_menu_get_item_called(TWidget* this, const char* s) {
     int xi = 0;
     _MAKETHIS;
+    if (data->prov.fetch) {
+        // paging the whole list through to look would cost a fetch a page
+        if (!data->prov.lookup) return 0;
+        xi = data->prov.lookup(data->prov.ctx, s);
+        return (xi >= 0 && xi < data->items) ? item_at(this, xi) : 0;
+    }
     if (data->menu) {
+        ttk_menu_item *item, *found = 0;
+        unsigned int h = name_hash(s);
+
+        if (!data->hash) build_hash(data);
+        while ((item = data->hash[h++ & (data->hashsize - 1)])) {
+            if (strcmp(item->name, s)) continue;
+            if (found) break;  // more than one; find the first
+            found = item;
+        }
+        if (!item) return found;
+
         for (xi = 0; data->menu[xi] && data->menu[xi]->name; xi++) {
             if (!strcmp(data->menu[xi]->name, s)) return data->menu[xi];
         }
@@ -262,15 +757,16 @@ ttk_menu_item* ttk_menu_get_item_called(TWidget* this, const char* s) {
 
 ttk_menu_item* ttk_menu_get_selected_item(TWidget* this) {
     _MAKETHIS;
-    return data->menu[data->xivi[data->top + data->sel]];
+    return item_at(this, XI(data, data->top + data->sel));
 }
 
 void ttk_menu_item_updated(TWidget* this, ttk_menu_item* p) {
-    _MAKETHIS;
+    menu_data* data;
     int i;
 
     if (!this) this = p->menu;
     p->menu = this;
+    data = this->data;
 
     if (p->choices) {
         const char** q = p->choices;
@@ -289,15 +785,12 @@ void ttk_menu_item_updated(TWidget* this, ttk_menu_item* p) {
     p->menuwidth = this->w;
     p->menuheight = this->h;
 
-    if (data->i18nable)
-        p->textwidth =
-            ttk_text_width(data->font,
-                           ttk_filter_sorting_characters(gettext(p->name))) +
-            4;
-    else
-        p->textwidth =
-            ttk_text_width(data->font, ttk_filter_sorting_characters(p->name)) +
-            4;
+    forget_row(p);  // measured and rendered again when next drawn
+    if (p->sortsrc && p->menudata == data) data->keysdead++;
+    p->sortsrc = 0;  // keyed again when next sorted
+    // Items being added aren't ours yet, and go in the index by themselves;
+    // one already in the menu may have a new name.
+    if (p->menudata == data) forget_index(data);
 
     p->iconflash = 3;
     p->flags |= TTK_MENU_ICON_FLASHOFF;
@@ -325,146 +818,160 @@ void ttk_menu_item_updated(TWidget* this, ttk_menu_item* p) {
 
 static int menu_return_false(struct ttk_menu_item* item) { return 0; }
 
-void ttk_menu_remove_by_name(TWidget* this, const char* name) {
+static int move_selection(TWidget* this, int dir);
+
+// Items from xi on may have appeared or disappeared since the last index.
+static void visibility_changed(TWidget* this, int xi) {
+    _MAKETHIS;
+
+    index_from(this, xi);
+    move_selection(this, 0);
+    this->dirty++;
+}
+
+static int index_of(TWidget* this, ttk_menu_item* item) {
     _MAKETHIS;
     int xi;
 
+    if (data->prov.fetch) return -1;  // the provider owns the list
+    for (xi = 0; xi < data->items; xi++)
+        if (data->menu[xi] == item) return xi;
+    return -1;
+}
+
+void ttk_menu_item_visibility_changed(TWidget* this, ttk_menu_item* item) {
+    int xi;
+
+    if (!this) this = item->menu;
+    if ((xi = index_of(this, item)) >= 0 && check_visible(this, xi))
+        visibility_changed(this, xi);
+}
+
+void ttk_menu_visibility_changed(TWidget* this) {
+    _MAKETHIS;
+    int xi, first = -1;
+    if (data->prov.fetch) return;
+
+    for (xi = 0; xi < data->items; xi++)
+        if (check_visible(this, xi) && first < 0) first = xi;
+    if (first >= 0) visibility_changed(this, first);
+}
+
+void ttk_menu_remove_by_name(TWidget* this, const char* name) {
+    _MAKETHIS;
+    int xi, first = -1;
+    if (data->prov.fetch) return;
+
     for (xi = 0; data->menu[xi]; xi++) {
-        if (!strcmp(data->menu[xi]->name, name))
+        if (!strcmp(data->menu[xi]->name, name)) {
             data->menu[xi]->visible = menu_return_false;
+            data->menu[xi]->hidden = 1;
+            if (first < 0) first = xi;
+        }
     }
-    MakeVIXI(this);
-    render(this, data->top, data->visible);
+    if (first >= 0) visibility_changed(this, first);
 }
 
 void ttk_menu_remove_by_ptr(TWidget* this, ttk_menu_item* item) {
     _MAKETHIS;
+    int xi = index_of(this, item);
 
+    if (data->prov.fetch) return;
     item->visible = menu_return_false;
-    MakeVIXI(this);
-    render(this, data->top, data->visible);
+    item->hidden = 1;
+    if (xi >= 0) visibility_changed(this, xi);
 }
 
 void ttk_menu_remove(TWidget* this, int xi) {
     _MAKETHIS;
+    if (data->prov.fetch) return;
 
     data->menu[xi]->visible = menu_return_false;
-    MakeVIXI(this);
-    render(this, data->top, data->visible);
+    data->menu[xi]->hidden = 1;
+    visibility_changed(this, xi);
 }
 
-static void free_renderings(TWidget* this, int first, int n) {
-    int vi, xi;
-    _MAKETHIS;
-
-    if (first >= data->items) {
-        fprintf(stderr, "Menu render started after end\n");
-        return;
-    }
-
-    for (xi = 0, vi = data->vixi[0]; data->menu[xi] && vi < first + n;
-         xi++, vi = data->vixi[xi]) {
-        if (vi < first) continue;
-
-        if (data->itemsrf[xi]) ttk_free_surface(data->itemsrf[xi]);
-        if (data->itemsrfI[xi]) ttk_free_surface(data->itemsrfI[xi]);
-
-        data->itemsrf[xi] = data->itemsrfI[xi] = 0;
-    }
+// Makes space for n more items and the terminator, doubling so a menu
+// filled one item at a time isn't copied every 50.
+static void make_room(menu_data* data, int n) {
+    if (data->items + n < data->allocation) return;
+    data->allocation = MAX(data->allocation * 2, data->items + n + 50);
+    data->menu = realloc(data->menu, sizeof(void*) * data->allocation);
+    data->vixi = realloc(data->vixi, sizeof(int) * data->allocation);
+    data->xivi = realloc(data->xivi, sizeof(int) * data->allocation);
 }
 
 void ttk_menu_insert(TWidget* this, ttk_menu_item* item, int xi) {
     _MAKETHIS;
+    if (data->prov.fetch) return;
 
     if (xi >= data->items) {
         ttk_menu_append(this, item);
         return;
     }
 
-    if (data->items >= data->allocation) {
-        data->allocation = data->items + 50;
-        data->menu = realloc(data->menu, sizeof(void*) * data->allocation);
-        data->vixi = realloc(data->vixi, sizeof(int) * data->allocation);
-        data->xivi = realloc(data->xivi, sizeof(int) * data->allocation);
-        if (data->itemsrf) {
-            data->itemsrf =
-                realloc(data->itemsrf, data->allocation * sizeof(ttk_surface));
-            memset(data->itemsrf + data->items, 0,
-                   (data->allocation - data->items) * sizeof(ttk_surface));
-        }
-        if (data->itemsrfI) {
-            data->itemsrfI =
-                realloc(data->itemsrfI, data->allocation * sizeof(ttk_surface));
-            memset(data->itemsrfI + data->items, 0,
-                   (data->allocation - data->items) * sizeof(ttk_surface));
-        }
-    }
-
+    make_room(data, 1);
     memmove(data->menu + xi + 1, data->menu + xi,
             sizeof(void*) * (data->items - xi));
-    if (data->itemsrf)
-        memmove(data->itemsrf + xi + 1, data->itemsrf + xi,
-                sizeof(ttk_surface) * (data->items - xi));
-    if (data->itemsrfI)
-        memmove(data->itemsrfI + xi + 1, data->itemsrfI + xi,
-                sizeof(ttk_surface) * (data->items - xi));
-    data->itemsrf[xi] = data->itemsrfI[xi] = 0;
     data->menu[xi] = item;
     data->items++;
+    data->menu[data->items] = 0;
+    index_insert(data, xi);
 
     ttk_menu_item_updated(this, item);
-    MakeVIXI(this);
     item->menudata = data;
-    if (data->vixi[xi] - data->top - 1 <= data->visible) {
-        render(this, data->top, data->visible);
-    }
+    check_visible(this, xi);
+    index_from(this, xi);
+    if (data->vixi[xi] - data->top - 1 <= data->visible) this->dirty++;
 }
 
 void ttk_menu_append(TWidget* this, ttk_menu_item* item) {
     _MAKETHIS;
+    if (data->prov.fetch) return;
 
-    if (data->items >= data->allocation - 1) {
-        data->allocation = data->items + 50;
-        data->menu = realloc(data->menu, sizeof(void*) * data->allocation);
-        data->vixi = realloc(data->vixi, sizeof(int) * data->allocation);
-        data->xivi = realloc(data->xivi, sizeof(int) * data->allocation);
-        if (data->itemsrf) {
-            data->itemsrf =
-                realloc(data->itemsrf, data->allocation * sizeof(ttk_surface));
-            memset(data->itemsrf + data->items, 0,
-                   (data->allocation - data->items) * sizeof(ttk_surface));
-        }
-        if (data->itemsrfI) {
-            data->itemsrfI =
-                realloc(data->itemsrfI, data->allocation * sizeof(ttk_surface));
-            memset(data->itemsrfI + data->items, 0,
-                   (data->allocation - data->items) * sizeof(ttk_surface));
-        }
-    }
-
+    make_room(data, 1);
     data->menu[data->items] = item;
     data->items++;
     data->menu[data->items] = 0;
+    index_insert(data, data->items - 1);
 
     ttk_menu_item_updated(this, item);
     item->menudata = data;
-    if (data->items < 2 ||
-        (data->menu[data->items - 2]->visible &&
-         !data->menu[data->items - 2]->visible(data->menu[data->items - 2]))) {
-        MakeVIXI(this);
-    } else {
-        if (!item->visible || item->visible(item)) {
-            data->vixi[data->items - 1] = data->vitems;
-            data->xivi[data->vitems] = data->items - 1;
-            data->vitems++;
-        } else {
-            data->vixi[data->items - 1] = data->vitems - 1;
-        }
-        data->scroll = (data->vitems > data->visible);
-    }
-    if (data->vitems - data->top - 1 <= data->visible) {
-        render(this, data->top, data->visible);
+    check_visible(this, data->items - 1);
+    index_from(this, data->items - 1);
+    if (data->vitems - data->top - 1 <= data->visible) this->dirty++;
+}
+
+// Like n calls to ttk_menu_insert(), but the items are moved up once,
+// and the index of visible items and the name index are made again once.
+void ttk_menu_insert_items(TWidget* this, ttk_menu_item** items, int n,
+                           int xi) {
+    _MAKETHIS;
+    int i;
+
+    if (data->prov.fetch || n <= 0) return;
+    if (xi > data->items) xi = data->items;
+
+    make_room(data, n);
+    memmove(data->menu + xi + n, data->menu + xi,
+            sizeof(void*) * (data->items - xi));
+    memcpy(data->menu + xi, items, sizeof(void*) * n);
+    data->items += n;
+    data->menu[data->items] = 0;
+    forget_index(data);
+
+    for (i = xi; i < xi + n; i++) {
+        ttk_menu_item_updated(this, data->menu[i]);
+        data->menu[i]->menudata = data;
+        check_visible(this, i);
     }
+    index_from(this, xi);
+    if (data->vixi[xi] - data->top - 1 <= data->visible) this->dirty++;
+}
+
+void ttk_menu_append_items(TWidget* this, ttk_menu_item** items, int n) {
+    _MAKETHIS;
+    ttk_menu_insert_items(this, items, n, data->items);
 }
 
 /* menu sorting functions */
@@ -490,35 +997,6 @@ static int my_strcasecmp_nulls(const char* s1, const char* s2) {
     return strcasecmp(s1, s2);
 }
 
-static int sort_compare_i18n(const void* a, const void* b) {
-    ttk_menu_item *A = *(ttk_menu_item**)a, *B = *(ttk_menu_item**)b;
-    return my_strcasecmp_nulls(gettext(A->name), gettext(B->name));
-}
-static int sort_compare(const void* a, const void* b) {
-    ttk_menu_item *A = *(ttk_menu_item**)a, *B = *(ttk_menu_item**)b;
-    return my_strcasecmp_nulls(A->name, B->name);
-}
-static int sort_compare_i18n_g(const void* a, const void* b) {
-    int compared_group;
-    ttk_menu_item *A = *(ttk_menu_item**)a, *B = *(ttk_menu_item**)b;
-
-    compared_group =
-        my_strcasecmp_nulls(gettext(A->group_name), gettext(B->group_name));
-    if (compared_group == 0)
-        return my_strcasecmp_nulls(gettext(A->name), gettext(B->name));
-
-    return (compared_group);
-}
-static int sort_compare_g(const void* a, const void* b) {
-    int compared_group;
-    ttk_menu_item *A = *(ttk_menu_item**)a, *B = *(ttk_menu_item**)b;
-
-    compared_group = my_strcasecmp_nulls(A->group_name, B->group_name);
-    if (compared_group == 0) return my_strcasecmp_nulls(A->name, B->name);
-
-    return (compared_group);
-}
-
 /* ttk_menu_hint_groups
         - put the FIRST, MIDDLE, LAST, etc hints on the structure
 */
@@ -529,6 +1007,8 @@ int ttk_menu_hint_groups(TWidget* this) {
     ttk_menu_item* tmi = NULL;
     ttk_menu_item* pmi = NULL;
 
+    if (data->prov.fetch) return 0;
+
     for (count = 0; count < data->items; count++) {
         tmi = data->menu[count];
 
@@ -586,15 +1066,19 @@ int ttk_menu_hint_groups(TWidget* this) {
         - remove the group header items too
 */
 void ttk_menu_remove_groups(TWidget* this) {
-    int count = 0;
+    int count = 0, first = -1;
     _MAKETHIS;
     ttk_menu_item* tmi = NULL;
     ttk_menu_item* pmi = NULL;
 
+    if (data->prov.fetch) return;
+
     for (count = 0; count < data->items; count++) {
         tmi = data->menu[count];
         if (tmi->group_flags & TTK_MENU_GROUP_HEADER) {
             tmi->visible = menu_return_false;
+            tmi->hidden = 1;
+            if (first < 0) first = count;
             /*
                                     pmi->group_name = strdup(
                ttk_filter_sorting_characters(tmi->group_name) ); pmi->name =
@@ -605,63 +1089,237 @@ void ttk_menu_remove_groups(TWidget* this) {
         /* clear the group info */
         tmi->group_flags &= ~TTK_MENU_GROUP_SET;
     }
+    if (first >= 0) visibility_changed(this, first);
 }
 
 /* ttk_menu_create_group_headers
         - create the special entries in the list for the group headers
+        - in one pass from the end, moving each item only once
 */
+#define NEEDS_HEADER(tmi)                                          \
+    (((tmi)->group_flags & TTK_MENU_GROUP_FIRST ||                 \
+      (tmi)->group_flags & TTK_MENU_GROUP_ONLY) &&                 \
+     !((tmi)->group_flags & TTK_MENU_GROUP_HEADER))
+
 void ttk_menu_create_group_headers(TWidget* this) {
-    int count = 0;
+    int count = 0, nHeaders = 0, xi;
     _MAKETHIS;
     ttk_menu_item* tmi = NULL;
     ttk_menu_item* pmi = NULL;
 
-    for (count = 0; count < data->items; count++) {
+    if (data->prov.fetch) return;
+
+    for (count = 0; count < data->items; count++)
+        if (NEEDS_HEADER(data->menu[count])) nHeaders++;
+    if (!nHeaders) return;
+
+    make_room(data, nHeaders);
+    xi = data->items + nHeaders;
+    data->menu[xi] = 0;
+    for (count = data->items - 1; count >= 0; count--) {
         tmi = data->menu[count];
-        if ((tmi->group_flags & TTK_MENU_GROUP_FIRST) ||
-            (tmi->group_flags & TTK_MENU_GROUP_ONLY)) {
-            if ((tmi->group_flags & TTK_MENU_GROUP_HEADER) == 0) {
-                /* create the header item */
-                pmi = (ttk_menu_item*)calloc(1, sizeof(ttk_menu_item));
-                pmi->group_flags |= TTK_MENU_GROUP_HEADER;
-                if (tmi->group_name) {
-                    pmi->group_name =
-                        strdup(ttk_filter_sorting_characters(tmi->group_name));
-                    pmi->name =
-                        strdup(ttk_filter_sorting_characters(tmi->group_name));
-                } else {
-                    pmi->group_name = strdup("Unsorted");
-                    pmi->name = strdup("Unsorted");
-                }
-                ttk_menu_insert(this, pmi, count);
-                count++;
+        data->menu[--xi] = tmi;
+        if (!NEEDS_HEADER(tmi)) continue;
+
+        /* create the header item */
+        pmi = (ttk_menu_item*)calloc(1, sizeof(ttk_menu_item));
+        pmi->group_flags |= TTK_MENU_GROUP_HEADER;
+        if (tmi->group_name) {
+            pmi->group_name =
+                strdup(ttk_filter_sorting_characters(tmi->group_name));
+            pmi->name = strdup(ttk_filter_sorting_characters(tmi->group_name));
+        } else {
+            pmi->group_name = strdup("Unsorted");
+            pmi->name = strdup("Unsorted");
+        }
+        data->menu[--xi] = pmi;
+        ttk_menu_item_updated(this, pmi);
+        pmi->menudata = data;
+        check_visible(this, xi);
+    }
+    data->items += nHeaders;
+
+    forget_index(data);
+    index_from(this, 0);
+    this->dirty++;
+}
+
+typedef struct sort_ent {
+    unsigned int pfx;  // first four bytes of key
+    int rank;          // of the group: named, none, then named ~...
+    const char *key, *group;
+    int xi;
+} sort_ent;
+
+static unsigned int key_prefix(const char* s) {
+    unsigned int pfx = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        pfx <<= 8;
+        if (*s) pfx |= (unsigned char)*s++;
+    }
+    return pfx;
+}
+
+static int sort_ent_compare(const sort_ent* A, const sort_ent* B) {
+    int c;
+
+    if (A->rank != B->rank) return A->rank - B->rank;
+    if (A->group != B->group && (c = strcmp(A->group, B->group))) return c;
+    // no name goes last, but before names marked ~, as it always has
+    if (!A->key || !B->key) return my_strcasecmp_nulls(A->key, B->key);
+    if (A->pfx != B->pfx) return (A->pfx < B->pfx) ? -1 : 1;
+    return strcmp(A->key, B->key);
+}
+
+// Bottom-up and stable; a and b each hold n. Returns whichever of them
+// ended up with the result.
+static sort_ent* merge_sort(sort_ent* a, sort_ent* b, int n) {
+    sort_ent *src = a, *dst = b, *t;
+    int w, lo, mid, hi, i, j, k;
+
+    for (w = 1; w < n; w *= 2) {
+        for (lo = 0; lo < n; lo += 2 * w) {
+            mid = MIN(lo + w, n);
+            hi = MIN(lo + 2 * w, n);
+            // already in order, as runs of a nearly sorted menu will be
+            if (mid == hi || sort_ent_compare(&src[mid - 1], &src[mid]) <= 0) {
+                memcpy(dst + lo, src + lo, (hi - lo) * sizeof(sort_ent));
+                continue;
             }
+            for (i = lo, j = mid, k = lo; i < mid && j < hi;)
+                dst[k++] = (sort_ent_compare(&src[j], &src[i]) < 0) ? src[j++]
+                                                                    : src[i++];
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
         }
+        t = src, src = dst, dst = t;
     }
+    return src;
+}
+
+// Sorts the items by key, and first by group if bygroup.
+static void sort_items(TWidget* this, int bygroup) {
+    _MAKETHIS;
+    sort_ent *ent, *sorted;
+    ttk_menu_item** menu;
+    const char *src, *lastgroup = 0;
+    char* gkeys = 0;
+    int *gofs, glen = 0, galloc = 0, xi, n = data->items;
+
+    if (n <= 0) return;
+    if (data->keysdead > n) {
+        // mostly renamed since the block was made; make it again
+        for (xi = 0; xi < n; xi++) data->menu[xi]->sortsrc = 0;
+        data->keyslen = data->keysdead = 0;
+    }
+
+    ent = malloc(2 * n * sizeof(sort_ent));
+    gofs = malloc(n * sizeof(int));
+    for (xi = 0; xi < n; xi++) {
+        ttk_menu_item* item = data->menu[xi];
+
+        key_item(data, item);
+        ent[xi].xi = xi;
+        ent[xi].rank = 0;
+        gofs[xi] = -1;
+        if (!bygroup) continue;
+
+        // items of a group usually share its string; key it once per run
+        if (!item->group_name) {
+            ent[xi].rank = 1;
+        } else if (item->group_name == lastgroup) {
+            gofs[xi] = gofs[xi - 1];
+            ent[xi].rank = ent[xi - 1].rank;
+        } else {
+            src = data->i18nable ? gettext(item->group_name) : item->group_name;
+            if (*src == '~') ent[xi].rank = 2;
+            gofs[xi] = add_key(&gkeys, &glen, &galloc, src, 0);
+        }
+        lastgroup = item->group_name;
+    }
+    // both blocks are done growing, so pointers into them hold from here
+    for (xi = 0; xi < n; xi++) {
+        ent[xi].key =
+            data->menu[xi]->name ? data->keys + data->menu[xi]->sortkey : 0;
+        ent[xi].pfx = ent[xi].key ? key_prefix(ent[xi].key) : 0;
+        ent[xi].group = (gofs[xi] < 0) ? "" : gkeys + gofs[xi];
+    }
+
+    sorted = merge_sort(ent, ent + n, n);
+    menu = malloc(n * sizeof(void*));
+    for (xi = 0; xi < n; xi++) menu[xi] = data->menu[sorted[xi].xi];
+    memcpy(data->menu, menu, n * sizeof(void*));
+
+    free(menu);
+    free(gofs);
+    free(gkeys);
+    free(ent);
+}
+
+void ttk_menu_set_sort_articles(TWidget* this, const char** articles) {
+    _MAKETHIS;
+    int xi;
+
+    data->articles = articles;
+    for (xi = 0; xi < data->items; xi++) data->menu[xi]->sortsrc = 0;
+    data->keyslen = data->keysdead = 0;
+    forget_index(data);  // it's built from the keys
 }
 
 void ttk_menu_sort_my_way(TWidget* this, int (*cmp)(const void*, const void*)) {
     _MAKETHIS;
+    if (data->prov.fetch) return;
     qsort(data->menu, data->items, sizeof(void*), cmp);
-    MakeVIXI(this);
-    render(this, data->top, data->visible);
+    forget_index(data);
+    index_from(this, 0);
+    this->dirty++;
 }
 
 void ttk_menu_sort(TWidget* this) {
     _MAKETHIS;
-    if (data->i18nable)
-        ttk_menu_sort_my_way(this, sort_compare_i18n);
-    else
-        ttk_menu_sort_my_way(this, sort_compare);
+    if (data->prov.fetch) return;
+    sort_items(this, 0);
+    forget_index(data);
+    index_from(this, 0);
+    this->dirty++;
 }
 
-void ttk_menu_sort_my_way_groups(TWidget* this,
-                                 int (*cmp)(const void*, const void*)) {
-    int nGroups = 0;
+// Frees the headers an earlier grouping made. Left in, each would sort to
+// the front of its group and stand in for that group's new header.
+static void drop_headers(TWidget* this) {
     _MAKETHIS;
+    ttk_menu_item* item;
+    int xi, n = 0;
 
-    ttk_menu_remove_groups(this);
-    qsort(data->menu, data->items, sizeof(void*), cmp);
+    for (xi = 0; xi < data->items; xi++) {
+        item = data->menu[xi];
+        if (!(item->group_flags & TTK_MENU_GROUP_HEADER)) {
+            data->menu[n++] = item;
+            continue;
+        }
+        forget_row(item);
+        if (item->sortsrc) data->keysdead++;
+        free((char*)item->name);
+        free(item->group_name);
+        free(item);
+    }
+    data->items = n;
+    data->menu[n] = 0;
+}
+
+// After the items of a grouped menu are sorted: mark the groups and give
+// each a header.
+static void regroup(TWidget* this) {
+    _MAKETHIS;
+    int nGroups;
+
+    forget_index(data);
+    if (!data->items) {  // it was only headers
+        visibility_changed(this, 0);
+        return;
+    }
 
     nGroups =
         ttk_menu_hint_groups(this); /* put the header hints on the groups */
@@ -672,17 +1330,28 @@ void ttk_menu_sort_my_way_groups(TWidget* this,
         ttk_menu_create_group_headers(this);
     }
 
-    MakeVIXI(this);
-    render(this, data->top, data->visible);
+    visibility_changed(this, 0);
+}
+
+void ttk_menu_sort_my_way_groups(TWidget* this,
+                                 int (*cmp)(const void*, const void*)) {
+    _MAKETHIS;
+
+    if (data->prov.fetch) return;
+    drop_headers(this);
+    ttk_menu_remove_groups(this);
+    qsort(data->menu, data->items, sizeof(void*), cmp);
+    regroup(this);
 }
 
 void ttk_menu_sort_groups(TWidget* this) {
     _MAKETHIS;
+
+    if (data->prov.fetch || !data->items) return;
+    drop_headers(this);
     ttk_menu_remove_groups(this);
-    if (data->i18nable)
-        ttk_menu_sort_my_way_groups(this, sort_compare_i18n_g);
-    else
-        ttk_menu_sort_my_way_groups(this, sort_compare_g);
+    sort_items(this, 1);
+    regroup(this);
 }
 
 /* other menu stuff */
@@ -693,6 +1362,20 @@ void ttk_menu_updated(TWidget* this) {
 
     int olditems = data->items;
 
+    if (data->prov.fetch) {
+        drop_pages(this);
+        data->items = data->vitems = data->prov.count(data->prov.ctx);
+        data->scroll = (data->vitems > data->visible);
+        if (data->top + data->sel >= data->items)
+            data->top = data->sel = 0;
+        move_selection(this, 0);
+        this->dirty++;
+        return;
+    }
+
+    forget_rows(this);
+
+    forget_index(data);
     p = data->mlist;
     data->items = 0;
     while (p && p->name) {
@@ -700,7 +1383,8 @@ void ttk_menu_updated(TWidget* this) {
         data->items++;
     }
     data->allocation = data->items + 50;
-    if (data->vixi) free(data->vixi);
+    free(data->vixi);
+    free(data->xivi);
     data->vixi = calloc(data->allocation, sizeof(int));
     data->xivi = calloc(data->allocation, sizeof(int));
 
@@ -735,15 +1419,26 @@ int ttk_menu_frame(TWidget* this) {
     ttk_menu_item* selected;
     _MAKETHIS;
 
-    if (!data->menu || !data->items) return 0;
+    sub_reap();
+    if (!HAVE_ITEMS(data)) return 0;
+
+    if (data->moving) {
+        int now = ttk_getticks();
+
+        ttk_menu_glide(this, now - data->lastglide);
+        data->lastglide = now;
+        // the rest keeps to its usual 10 fps
+        if (now - data->ticked < 100) return 0;
+        data->ticked = now;
+    }
 
     // only do this when our position has changed
     if (pos != (data->top + data->sel)) {
-        ttk_menu_scroll(this, 0);  // adjust for header group headings
+        move_selection(this, 0);  // adjust for header group headings
         pos = data->top + data->sel;
     }
 
-    selected = data->menu[data->xivi[data->top + data->sel]];
+    selected = item_at(this, XI(data, data->top + data->sel));
 
     data->ds++;
 
@@ -800,14 +1495,24 @@ int ttk_menu_frame(TWidget* this) {
 
     if ((data->ds % 2) == 0 && selected->textflash) selected->textflash--;
 
-    // Redraw every ~1s, in case menu items change visibility / fonts change
     if ((oldflags != selected->flags) ||
-        (oldflash != ((selected->textflash << 8) | selected->iconflash)) ||
-        !(data->ds % 10)) {
-        if (!(data->ds % 10)) MakeVIXI(this);
+        (oldflash != ((selected->textflash << 8) | selected->iconflash)))
         this->dirty++;
+
+    // Every ~1s, notice rows on screen that have hidden themselves. Items
+    // elsewhere are only looked at again when we're told they've changed.
+    if (!(data->ds % 10) && !data->prov.fetch) {
+        int vi, first = -1;
+        for (vi = data->top; vi < MIN(data->top + data->visible, data->vitems);
+             vi++) {
+            if (check_visible(this, data->xivi[vi]) && first < 0)
+                first = data->xivi[vi];
+        }
+        if (first >= 0) visibility_changed(this, first);
     }
 
+    if (data->lastdir) prefetch(this);
+
     return 0;
 }
 
@@ -826,11 +1531,13 @@ TWidget* ttk_new_menu_widget(ttk_menu_item* items, ttk_font font, int w,
     ret->data = data;
     ret->focusable = 1;
     ret->draw = ttk_menu_draw;
+    ret->type = "menu";
     ret->frame = ttk_menu_frame;
     ret->down = ttk_menu_down;
     ret->button = ttk_menu_button;
     ret->scroll = ttk_menu_scroll;
     ret->destroy = ttk_menu_free;
+    ret->input = ttk_menu_input;
 
     data->visible = h / (ttk_text_height(font) + 4);
     data->itemheight = h / data->visible;
@@ -841,16 +1548,236 @@ TWidget* ttk_new_menu_widget(ttk_menu_item* items, ttk_font font, int w,
     data->epoch = ttk_epoch;
     data->free_everything = !items;
     data->drawn = 0;
+    data->smooth = 0;  // see ttk_menu_set_smooth()
 
     ttk_widget_set_fps(ret, 10);
 
     ttk_menu_updated(ret);
-    render(ret, 0, data->visible);
 
     ret->dirty = 1;
     return ret;
 }
 
+TWidget* ttk_new_menu_widget_provider(ttk_menu_provider* prov, ttk_font font,
+                                      int w, int h) {
+    TWidget* ret = ttk_new_menu_widget(0, font, w, h);
+    menu_data* data = ret->data;
+    int i;
+
+    data->free_everything = 0;
+    data->prov = *prov;
+    data->pages = calloc(MENU_PAGES, sizeof(menu_page));
+    for (i = 0; i < MENU_PAGES; i++) data->pages[i].first = -1;
+
+    ttk_menu_updated(ret);
+    return ret;
+}
+
+// Everything looked at for each item when sorting or counting is in the
+// first arrays; the rest is only needed for rows being fetched.
+struct ttk_menu_list {
+    int n, alloc;
+    unsigned int* key;     // first four bytes of the name, lowercased
+    unsigned short* flags;
+    unsigned char* hidden;
+    int* order;            // every entry, in display order
+    int *row, rows, stale; // the entries not hidden, in order
+    int sorted;            // by name, since the last add
+
+    int* name;  // offsets into names
+    void** data;
+    char* names;
+    int namelen, namealloc;
+    TWindow* (*makesub)(ttk_menu_item* item);
+};
+
+ttk_menu_list* ttk_new_menu_list(TWindow* (*makesub)(ttk_menu_item* item)) {
+    ttk_menu_list* ret = calloc(1, sizeof(ttk_menu_list));
+    ret->makesub = makesub;
+    return ret;
+}
+
+void ttk_free_menu_list(ttk_menu_list* list) {
+    free(list->key);
+    free(list->flags);
+    free(list->hidden);
+    free(list->order);
+    free(list->row);
+    free(list->name);
+    free(list->data);
+    free(list->names);
+    free(list);
+}
+
+static unsigned int name_key(const char* s) {
+    unsigned int key = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        key <<= 8;
+        if (*s) key |= tolower((unsigned char)*s++);
+    }
+    return key;
+}
+
+int ttk_menu_list_add(ttk_menu_list* list, const char* name, int flags,
+                      void* data) {
+    int e = list->n, len = strlen(name) + 1;
+
+    if (list->n == list->alloc) {
+        list->alloc = list->alloc ? list->alloc * 2 : 256;
+        list->key = realloc(list->key, list->alloc * sizeof(unsigned int));
+        list->flags =
+            realloc(list->flags, list->alloc * sizeof(unsigned short));
+        list->hidden = realloc(list->hidden, list->alloc);
+        list->order = realloc(list->order, list->alloc * sizeof(int));
+        list->row = realloc(list->row, list->alloc * sizeof(int));
+        list->name = realloc(list->name, list->alloc * sizeof(int));
+        list->data = realloc(list->data, list->alloc * sizeof(void*));
+    }
+    while (list->namelen + len > list->namealloc) {
+        list->namealloc = list->namealloc ? list->namealloc * 2 : 4096;
+        list->names = realloc(list->names, list->namealloc);
+    }
+
+    memcpy(list->names + list->namelen, name, len);
+    list->name[e] = list->namelen;
+    list->namelen += len;
+    list->key[e] = name_key(name);
+    list->flags[e] = flags;
+    list->hidden[e] = 0;
+    list->order[e] = e;
+    list->data[e] = data;
+    list->n++;
+    list->stale = 1;
+    list->sorted = 0;
+    return e;
+}
+
+void ttk_menu_list_set_visible(ttk_menu_list* list, int e, int visible) {
+    list->hidden[e] = !visible;
+    list->stale = 1;
+}
+
+typedef struct list_sortent {
+    unsigned int key;
+    int e;
+} list_sortent;
+
+static ttk_menu_list* sorting;
+
+static int list_compare(const void* a, const void* b) {
+    const list_sortent *A = a, *B = b;
+    int c;
+
+    if (A->key != B->key) return (A->key < B->key) ? -1 : 1;
+    if ((c = strcasecmp(sorting->names + sorting->name[A->e],
+                        sorting->names + sorting->name[B->e])))
+        return c;
+    return A->e - B->e;  // stable, like ttk_menu_sort()
+}
+
+// Like ttk_menu_sort(), but the keys sit next to each other and most
+// comparisons never look at a name.
+void ttk_menu_list_sort(ttk_menu_list* list) {
+    list_sortent* ent = malloc(list->n * sizeof(list_sortent) + 1);
+    int i;
+
+    for (i = 0; i < list->n; i++) {
+        ent[i].key = list->key[i];
+        ent[i].e = i;
+    }
+    sorting = list;
+    qsort(ent, list->n, sizeof(list_sortent), list_compare);
+    for (i = 0; i < list->n; i++) list->order[i] = ent[i].e;
+    free(ent);
+    list->stale = 1;
+    list->sorted = 1;
+}
+
+static int list_count(void* ctx) {
+    ttk_menu_list* list = ctx;
+    int i;
+
+    if (list->stale) {
+        list->rows = 0;
+        for (i = 0; i < list->n; i++)
+            if (!list->hidden[list->order[i]])
+                list->row[list->rows++] = list->order[i];
+        list->stale = 0;
+    }
+    return list->rows;
+}
+
+static void list_fetch(void* ctx, int first, int n, ttk_menu_item* out) {
+    ttk_menu_list* list = ctx;
+    int i, e;
+
+    for (i = 0; i < n; i++) {
+        e = list->row[first + i];
+        out[i].name = list->names + list->name[e];
+        out[i].flags = list->flags[e];
+        out[i].data = list->data[e];
+        out[i].makesub = list->makesub;
+        out[i].cdata = e;
+    }
+}
+
+static int list_find(void* ctx, const char* prefix) {
+    ttk_menu_list* list = ctx;
+    int len = strlen(prefix), lo = 0, hi, mid, i;
+
+    list_count(list);
+    hi = list->rows;
+    if (!list->sorted) {
+        for (i = 0; i < list->rows; i++)
+            if (!strncasecmp(list->names + list->name[list->row[i]], prefix,
+                             len))
+                return i;
+        return -1;
+    }
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (strcasecmp(list->names + list->name[list->row[mid]], prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < list->rows &&
+        !strncasecmp(list->names + list->name[list->row[lo]], prefix, len))
+        return lo;
+    return -1;
+}
+
+static int list_lookup(void* ctx, const char* name) {
+    ttk_menu_list* list = ctx;
+    int i = 0;
+
+    if (list->sorted) {
+        // names that differ only in case sort together
+        i = list_find(list, name);
+        if (i < 0) return -1;
+    } else {
+        list_count(list);
+    }
+    for (; i < list->rows; i++) {
+        const char* s = list->names + list->name[list->row[i]];
+        if (!strcmp(s, name)) return i;
+        if (list->sorted && strcasecmp(s, name)) break;
+    }
+    return -1;
+}
+
+TWidget* ttk_new_menu_widget_list(ttk_menu_list* list, ttk_font font, int w,
+                                  int h) {
+    ttk_menu_provider prov = {list_count, list_fetch, 0,
+                              list,       list_find,  list_lookup};
+    TWidget* ret = ttk_new_menu_widget_provider(&prov, font, w, h);
+
+    ((menu_data*)ret->data)->list = list;
+    return ret;
+}
+
 void ttk_menu_set_closeable(TWidget* this, int closeable) {
     _MAKETHIS;
     data->closeable = closeable;
@@ -858,32 +1785,279 @@ void ttk_menu_set_closeable(TWidget* this, int closeable) {
 void ttk_menu_set_i18nable(TWidget* this, int i18nable) {
     _MAKETHIS;
     data->i18nable = i18nable;
+    forget_index(data);  // it sorts on the names shown
 }
 
-void ttk_menu_draw(TWidget* this, ttk_surface srf) {
+// What a slot in the ring was last drawn with; it's drawn again if any
+// of this no longer holds.
+typedef struct menu_slot {
+    ttk_menu_item* item;  // 0 if nothing is there
+    int vi, stamp, selected, iconflash, textofs, choice, icon, scroll;
+} menu_slot;
+
+// One row of the menu as it looks now, at (x, y) on srf.
+static void draw_row(TWidget* this, ttk_surface srf, int x, int y,
+                     ttk_menu_item* item, int selected, ttk_surface row) {
     _MAKETHIS;
-    int i, y = this->y;
-    int ih = 0;
-    int hoffs = 0;
     int ofs = (data->itemheight - ttk_text_height(data->font)) / 2;
-    int nivis = 0;
+    int ih, hoffs;
+    ttk_color col = 0;
+    TApItem* bg;
+
+    /* if it's a header item, center it */
+    ih = item->group_flags & TTK_MENU_GROUP_HEADER;
+    hoffs = ih ? (this->w - item->textwidth) / 2 : 0;
+
+    bg = menu_ap(ih                                     ? AP_HDRBG
+                 : selected && !(item->textflash % 2) ? AP_SELBG
+                                                      : AP_BG);
+
+    /* draw out the menu listing */
+    if (selected && !(item->textflash % 2)) {
+        /* fill the background of the item */
+        ttk_ap_fillrect(srf, bg, x, y, x + this->w - 11 * data->scroll,
+                        y + data->itemheight);
+        ttk_blit_image_ex(row, item->textofs, 0, item->linewidth,
+                          data->itemheight, srf, x + hoffs, y);
+        col = menu_apx(ih ? AP_HDRFG : AP_SELFG)->color;
+
+    } else {
+        /* Draw it selected */
+        ttk_ap_fillrect(srf, bg, x, y, x + this->w - 11 * data->scroll,
+                        y + data->itemheight);
+        ttk_blit_image_ex(row, 0, 0, item->linewidth, data->itemheight, srf,
+                          x + hoffs, y);
+        col = menu_apx(ih ? AP_HDRFG : AP_FG)->color;
+    }
+
+    /* overlay input choices */
+    if (item->choices) {
+        ttk_text(srf, data->font,
+                 x + this->w - 4 - 11 * data->scroll -
+                     ttk_text_width(data->font, item->choices[item->choice]),
+                 y + ofs, col, item->choices[item->choice]);
+    }
+
+    /* overlay an icon if needed */
+    if (item->flags & TTK_MENU_ICON) {
+        TApItem* ap = menu_ap(selected ? AP_ICON0 + (item->iconflash & 3)
+                                       : AP_ICON);
+        if (ap) {
+            ttk_color bgcol = menu_apx(selected ? AP_SELBG : AP_BG)->color;
+            int ix = x + this->w + 1 - 11 * data->scroll - 11;
+            int iy = y + (data->itemheight - 13) / 2;
+
+            switch (item->flags & TTK_MENU_ICON) {
+                case TTK_MENU_ICON_SUB:
+                    ttk_draw_icon(ttk_icon_sub, srf, ix, iy, ap, bgcol);
+                    break;
+                case TTK_MENU_ICON_EXE:
+                    ttk_draw_icon(ttk_icon_exe, srf, ix, iy, ap, bgcol);
+                    break;
+                case TTK_MENU_ICON_SND:
+                    ttk_draw_icon(ttk_icon_spkr, srf, ix, iy, ap, bgcol);
+                    break;
+            }
+        }
+    }
+}
+
+// The rows on screen are kept drawn in a ring of visible + 1 slots, row vi
+// in slot vi % nslots. Scrolling only draws the rows that come into view,
+// and the ring is copied out in at most two blits. Where no row drew it's
+// still CKEY, as is the area it's copied to, so it's copied without a key.
+// A row's fills reach a line into the next one, which used to be painted
+// over but now may not be redrawn; that line is kept aside in linebuf.
+// Whether every row background is a plain color, so a slot needs no
+// clearing before it's drawn again. When it isn't and the menu doesn't
+// glide, rows are drawn straight to the window, which is cleared anyway.
+static int ring_plain(void) {
+    TApItem* ap[3];
+    int i;
+
+    ap[0] = menu_ap(AP_BG);
+    ap[1] = menu_ap(AP_SELBG);
+    ap[2] = menu_ap(AP_HDRBG);
+    for (i = 0; i < 3; i++)
+        if (!ap[i] || ap[i]->type != TTK_AP_COLOR) return 0;
+    return 1;
+}
+
+static void ring_check(TWidget* this) {
+    _MAKETHIS;
+    int n = data->visible + 1;
+
+    if (data->ring && data->ringw == this->w &&
+        data->ringh == n * data->itemheight)
+        return;
+    if (data->ring) ttk_free_surface(data->ring);
+    if (data->linebuf) ttk_free_surface(data->linebuf);
+    free(data->slots);
+    data->nslots = n;
+    data->ringw = this->w;
+    data->ringh = n * data->itemheight;
+    data->ring = ttk_new_surface(data->ringw, data->ringh, ttk_screen->bpp);
+    ttk_surface_set_opaque(data->ring);
+    data->linebuf = ttk_new_surface(data->ringw, 1, ttk_screen->bpp);
+    ttk_surface_set_opaque(data->linebuf);
+    data->slots = calloc(n, sizeof(menu_slot));
+}
+
+static void ring_update(TWidget* this, int vi) {
+    _MAKETHIS;
+    menu_slot* sl = data->slots + vi % data->nslots;
+    ttk_menu_item* item = item_at(this, XI(data, vi));
+    int selected = (vi == data->top + data->sel);
+    int lit = selected && !(item->textflash % 2);
+    int stamp, y;
+    ttk_surface row;
+
+    if (item->predraw) item->predraw(item);
+    row = row_surface(this, item, lit, &stamp);
+
+    if (sl->item == item && sl->vi == vi && sl->stamp == stamp &&
+        sl->selected == lit + selected && sl->choice == item->choice &&
+        sl->icon == (item->flags & TTK_MENU_ICON) &&
+        sl->scroll == data->scroll &&
+        (!selected ||
+         (sl->iconflash == item->iconflash && sl->textofs == item->textofs)))
+        return;
+
+    // What was drawn in the slot before has to go, and what the row doesn't
+    // cover shows through. A plain color covers all but the scrollbar's side.
+    y = (vi % data->nslots) * data->itemheight;
+    ttk_blit_image_ex(data->ring, 0, y + data->itemheight, this->w, 1,
+                      data->linebuf, 0, 0);
+    if (!ring_plain())
+        ttk_fillrect(data->ring, 0, y, this->w - 1, y + data->itemheight - 1,
+                     ttk_makecol(CKEY));
+    else if (data->scroll)
+        ttk_fillrect(data->ring, this->w - 11, y, this->w - 1,
+                     y + data->itemheight - 1, ttk_makecol(CKEY));
+    draw_row(this, data->ring, 0, y, item, selected, row);
+    ttk_blit_image_ex(data->linebuf, 0, 0, this->w, 1, data->ring, 0,
+                      y + data->itemheight);
+    sl->item = item;
+    sl->vi = vi;
+    sl->stamp = stamp;
+    sl->selected = lit + selected;
+    sl->choice = item->choice;
+    sl->icon = item->flags & TTK_MENU_ICON;
+    sl->scroll = data->scroll;
+    sl->iconflash = item->iconflash;
+    sl->textofs = item->textofs;
+}
+
+// Smooth scrolling: the view (vpos, in 1/65536ths of a pixel) is pulled
+// toward the row top is on by a critically damped spring, so it eases in
+// however fast the wheel turns. Times are in ms.
+#define GLIDE_W2 400      // 1/omega^2: settles in ~100ms
+#define GLIDE_DAMP 10     // 1/(2 omega)
+#define GLIDE_STEP 4      // longest integration step
+
+static long long glide_target(TWidget* this) {
+    _MAKETHIS;
+    return (long long)data->top * data->itemheight << 16;
+}
+
+void ttk_menu_glide(TWidget* this, int ms) {
+    _MAKETHIS;
+    long long diff, span = (long long)data->visible * data->itemheight << 16;
+    int h;
+
+    if (!data->moving) return;
+    this->dirty++;
+
+    // a long jump only shows its last screenful going by
+    diff = glide_target(this) - data->vpos;
+    if (diff > span) data->vpos += diff - span;
+    if (diff < -span) data->vpos += diff + span;
+
+    for (; ms > 0; ms -= h) {
+        h = MIN(ms, GLIDE_STEP);
+        diff = glide_target(this) - data->vpos;
+        data->vvel += (int)(diff / GLIDE_W2) * h - data->vvel / GLIDE_DAMP * h;
+        data->vpos += (long long)data->vvel * h;
+    }
+
+    diff = glide_target(this) - data->vpos;
+    if (diff < 0) diff = -diff;
+    if (diff < 0x4000 && data->vvel < 0x400 && data->vvel > -0x400) {
+        data->vpos = glide_target(this);
+        data->vvel = data->moving = 0;
+        ttk_widget_set_fps(this, 10);
+    }
+}
+
+void ttk_menu_set_smooth(TWidget* this, int smooth) {
+    _MAKETHIS;
+    data->smooth = smooth;
+    if (!smooth && data->moving) {
+        data->vpos = glide_target(this);
+        data->vvel = data->moving = 0;
+        ttk_widget_set_fps(this, 10);
+    }
+}
+
+// Draws the rows on screen straight to srf, for menus that don't use the
+// ring; see ring_plain().
+static void draw_rows(TWidget* this, ttk_surface srf) {
+    _MAKETHIS;
+    int vi, stamp;
+
+    if (data->slots) memset(data->slots, 0, data->nslots * sizeof(menu_slot));
+    for (vi = data->top; vi < MIN(data->top + data->visible, data->vitems);
+         vi++) {
+        ttk_menu_item* item = item_at(this, XI(data, vi));
+        int selected = (vi == data->top + data->sel);
+
+        if (item->predraw) item->predraw(item);
+        draw_row(this, srf, this->x,
+                 this->y + (vi - data->top) * data->itemheight, item, selected,
+                 row_surface(this, item, selected && !(item->textflash % 2),
+                             &stamp));
+    }
+}
+
+// Brings the ring up to date for the view at pixel pos and copies it out.
+static void draw_ring(TWidget* this, ttk_surface srf, int pos) {
+    _MAKETHIS;
+    int ih = data->itemheight;
+    int hview, ystart, part, vi;
+
+    ring_check(this);
+    for (vi = pos / ih; vi <= (pos + data->visible * ih - 1) / ih &&
+                        vi < data->vitems;
+         vi++)
+        ring_update(this, vi);
+
+    hview = MIN(data->visible, data->vitems) * ih;
+    ystart = pos % data->ringh;
+    part = MIN(hview, data->ringh - ystart);
+    ttk_blit_image_ex(data->ring, 0, ystart, this->w, part, srf, this->x,
+                      this->y);
+    if (part < hview)
+        ttk_blit_image_ex(data->ring, 0, 0, this->w, hview - part, srf,
+                          this->x, this->y + part);
+}
+
+void ttk_menu_draw(TWidget* this, ttk_surface srf) {
+    _MAKETHIS;
+    int ih, pos, maxpos;
     int spos, sheight;
-    int vi, xi;
 
     if (ttk_epoch > data->epoch) {
         int i;
         data->font = ttk_menufont;
         data->visible = this->h / (ttk_text_height(data->font) + 4);
         data->itemheight = this->h / data->visible;
-        for (i = 0; i < data->items; i++)
-            ttk_menu_item_updated(this, data->menu[i]);
-        render(this, data->top, data->visible);
-        data->epoch = ttk_epoch;
+        data->epoch = ttk_epoch;  // rows are measured again as drawn
     }
 
     if (!data->drawn) {
-        MakeVIXI(this);
+        // visible() may depend on things that changed since we were made
         data->drawn = 1;
+        ttk_menu_visibility_changed(this);
     }
 
     data->scroll = (data->vitems > data->visible);
@@ -900,144 +2074,50 @@ void ttk_menu_draw(TWidget* this, ttk_surface srf) {
         return;
     }
 
-    for (i = 0; i < data->items; i++) {
-        if (data->menu[i]->visible &&                  // function, and
-            !data->menu[i]->visible(data->menu[i])) {  // function returns 0
-            continue;
-        }
-
-        nivis++;
-    }
-
-    if (!data->menu) return;
-
-    for (vi = data->top, xi = data->xivi[data->top];
-         data->menu[xi] && vi < MIN(data->top + data->visible, data->vitems);
-         vi++, xi = data->xivi[vi]) {
-        ttk_color col = 0;
-        int selected = (vi == data->top + data->sel);
-
-        if (data->menu[xi]->visible && !data->menu[xi]->visible(data->menu[xi]))
-            continue;
-
-        if (data->menu[xi]->predraw) data->menu[xi]->predraw(data->menu[xi]);
-
-        /* if it's a header item, center it */
-        ih = data->menu[xi]->group_flags & TTK_MENU_GROUP_HEADER;
-        hoffs = ih ? (this->w - data->menu[xi]->textwidth) / 2 : 0;
-
-        /* draw out the menu listing */
-        if (vi == data->top + data->sel && !(data->menu[xi]->textflash % 2)) {
-            if (!data->itemsrfI[xi]) {
-                fprintf(stderr, "Null pointer (I)\n");
-                abort();
-            }
-
-            /* fill the background of the item */
-            ttk_ap_fillrect(srf, ttk_ap_get(ih ? "menu.hdrbg" : "menu.selbg"),
-                            this->x, y, this->x + this->w - 11 * data->scroll,
-                            y + data->itemheight);
-            ttk_blit_image_ex(data->itemsrfI[xi], data->menu[xi]->textofs, 0,
-                              data->menu[xi]->linewidth, data->itemheight, srf,
-                              this->x + hoffs, y);
-            col = ttk_ap_getx(ih ? "menu.hdrfg" : "menu.selfg")->color;
-
-        } else {
-            /* Draw it selected */
-            if (!data->itemsrf[xi]) {
-                fprintf(stderr, "Null pointer (N)\n");
-                abort();
-            }
-
-            ttk_ap_fillrect(srf, ttk_ap_get(ih ? "menu.hdrbg" : "menu.bg"),
-                            this->x, y, this->x + this->w - 11 * data->scroll,
-                            y + data->itemheight);
-            ttk_blit_image_ex(data->itemsrf[xi], 0, 0,
-                              data->menu[xi]->linewidth, data->itemheight, srf,
-                              this->x + hoffs, y);
-            col = ttk_ap_getx(ih ? "menu.hdrfg" : "menu.fg")->color;
-        }
-
-        /* overlay input choices */
-        if (data->menu[xi]->choices) {
-            ttk_text(srf, data->font,
-                     this->x + this->w - 4 - 11 * data->scroll -
-                         ttk_text_width(
-                             data->font,
-                             data->menu[xi]->choices[data->menu[xi]->choice]),
-                     y + ofs, col,
-                     data->menu[xi]->choices[data->menu[xi]->choice]);
-        }
-
-        /* overlay an icon if needed */
-        if (data->menu[xi]->flags & TTK_MENU_ICON) {
-            const char* prop = (!selected)                        ? "menu.icon"
-                               : (data->menu[xi]->iconflash == 3) ? "menu.icon3"
-                               : (data->menu[xi]->iconflash == 2) ? "menu.icon2"
-                               : (data->menu[xi]->iconflash == 1)
-                                   ? "menu.icon1"
-                                   : "menu.icon0";
-            TApItem* ap = ttk_ap_get(prop);
-            if (ap) {
-                ttk_color bgcol = (selected ? ttk_ap_getx("menu.selbg")->color
-                                            : ttk_ap_getx("menu.bg")->color);
-
-                switch (data->menu[xi]->flags & TTK_MENU_ICON) {
-                    case TTK_MENU_ICON_SUB:
-                        ttk_draw_icon(
-                            ttk_icon_sub, srf,
-                            this->x + this->w + 1 - 11 * data->scroll - 11,
-                            y + (data->itemheight - 13) / 2, ap, bgcol);
-                        break;
-                    case TTK_MENU_ICON_EXE:
-                        ttk_draw_icon(
-                            ttk_icon_exe, srf,
-                            this->x + this->w + 1 - 11 * data->scroll - 11,
-                            y + (data->itemheight - 13) / 2, ap, bgcol);
-                        break;
-                    case TTK_MENU_ICON_SND:
-                        ttk_draw_icon(
-                            ttk_icon_spkr, srf,
-                            this->x + this->w + 1 - 11 * data->scroll - 11,
-                            y + (data->itemheight - 13) / 2, ap, bgcol);
-                        break;
-                }
-            }
-        }
+    ih = data->itemheight;
+    if (!data->moving) data->vpos = glide_target(this);
+    maxpos = MAX(data->vitems - data->visible, 0) * ih;
+    pos = MAX(0, MIN((int)(data->vpos >> 16), maxpos));
 
-        y += data->itemheight;
-    }
+    if (!data->smooth && !ring_plain())
+        draw_rows(this, srf);
+    else
+        draw_ring(this, srf, pos);
 
     /* draw scrollbar */
     if (data->scroll) {
-        sheight = data->visible * (this->h) / nivis;
-        spos = data->top * (this->h - 2 * ttk_ap_getx("header.line")->spacing) /
-                   nivis -
-               1;
+        int line = menu_apx(AP_LINE)->spacing;
+
+        sheight = data->visible * (this->h) / data->vitems;
+        spos = (long long)pos * (this->h - 2 * line) / (data->vitems * ih) - 1;
 
         if (sheight < 3) sheight = 3;
 
-        ttk_ap_fillrect(srf, ttk_ap_get("scroll.bg"), this->x + this->w - 10,
-                        this->y + 2 * ttk_ap_getx("header.line")->spacing,
-                        this->x + this->w, this->y + this->h);
-        ttk_ap_rect(srf, ttk_ap_get("scroll.box"), this->x + this->w - 10,
-                    this->y + 2 * ttk_ap_getx("header.line")->spacing,
-                    this->x + this->w, this->y + this->h);
-        ttk_ap_fillrect(
-            srf, ttk_ap_get("scroll.bar"), this->x + this->w - 10,
-            this->y + 2 * ttk_ap_getx("header.line")->spacing + spos + 1,
-            this->x + this->w,
-            this->y + ttk_ap_getx("header.line")->spacing + spos + sheight + 1);
+        ttk_ap_fillrect(srf, menu_ap(AP_SCROLLBG), this->x + this->w - 10,
+                        this->y + 2 * line, this->x + this->w,
+                        this->y + this->h);
+        ttk_ap_rect(srf, menu_ap(AP_SCROLLBOX), this->x + this->w - 10,
+                    this->y + 2 * line, this->x + this->w, this->y + this->h);
+        ttk_ap_fillrect(srf, menu_ap(AP_SCROLLBAR), this->x + this->w - 10,
+                        this->y + 2 * line + spos + 1, this->x + this->w,
+                        this->y + line + spos + sheight + 1);
     }
 }
 
 int ttk_menu_scroll(TWidget* this, int dir) {
-    _MAKETHIS;
-    int oldtop, oldsel;
     TTK_SCROLLMOD(dir, 5);
     TTK_SCROLL_ACCEL(dir, 10, 50); /* TODO: Tune these constants */
 
-    if (!data || !data->menu || !data->items) return 0;
+    return move_selection(this, dir);
+}
+
+// Moves the selection by dir visible items, keeping it on screen and off
+// group headers; dir = 0 just puts it back in bounds.
+static int move_selection(TWidget* this, int dir) {
+    _MAKETHIS;
+    int oldtop, oldsel;
+
+    if (!data || !HAVE_ITEMS(data)) return 0;
     if (!data->vitems) return 0;
 
     oldtop = data->top;
@@ -1074,7 +2154,7 @@ int ttk_menu_scroll(TWidget* this, int dir) {
     }
 
     // If we have a group header, we need to skip it.
-    if (data->menu[data->xivi[data->top + data->sel]]->group_flags &
+    if (item_at(this, XI(data, data->top + data->sel))->group_flags &
         TTK_MENU_GROUP_HEADER) {
         // If it's a header and it's index is 0 (first item), we need to
         // increment scroll position to the next menu item
@@ -1101,25 +2181,23 @@ int ttk_menu_scroll(TWidget* this, int dir) {
     // Divide by zero check
     if (data->vitems)
         data->spos = data->top *
-                     (this->h - 2 * ttk_ap_getx("header.line")->spacing) /
+                     (this->h - 2 * menu_apx(AP_LINE)->spacing) /
                      data->vitems;
     else
         data->spos = 0;
 
     if ((oldtop != data->top) || (oldsel != data->sel)) {
         this->dirty++;
-        data->menu[data->xivi[oldtop + oldsel]]->textofs = 0;
-
-        if (oldtop != data->top) {
-            // Make sure the new items are rendered
-            if (oldtop < data->top) {
-                free_renderings(this, oldtop, data->top - oldtop);
-                render(this, oldtop + data->visible, data->top - oldtop);
-            } else {
-                free_renderings(this, data->top + data->visible,
-                                oldtop - data->top);
-                render(this, data->top, oldtop - data->top);
-            }
+        if (oldtop + oldsel < data->vitems)
+            item_at(this, XI(data, oldtop + oldsel))->textofs = 0;
+
+        if (oldtop != data->top) data->lastdir = (oldtop < data->top) ? 1 : -1;
+        if (oldtop != data->top && dir && data->smooth && !data->moving) {
+            // glide there from where the view was; see ttk_menu_frame()
+            data->vpos = (long long)oldtop * data->itemheight << 16;
+            data->moving = 1;
+            data->lastglide = ttk_getticks();
+            ttk_widget_set_fps(this, 60);
         }
 
         return TTK_EV_CLICK;
@@ -1127,17 +2205,229 @@ int ttk_menu_scroll(TWidget* this, int dir) {
     return 0;
 }
 
+// Submenu windows that makesub() made stay cached in item->sub, but all of
+// them share a byte budget: the ones shown least recently are freed to keep
+// within it, and made again when next selected. A window is kept while it,
+// or one opened from it, is up. One whose item went away while it was up
+// (a provider's page was dropped) is orphaned: kept with no item, and
+// freed as soon as it's down.
+typedef struct menu_sub {
+    ttk_menu_item* item;  // 0 if orphaned
+    TWidget* menu;  // the one item is in
+    TWindow* win;
+    int bytes;
+    struct menu_sub *prev, *next;  // most recently shown first
+} menu_sub;
+
+static menu_sub *sub_mru, *sub_lru;
+static int sub_bytes, sub_budget = 512 * 1024, sub_orphans;
+static void (*sub_evict_hook)(ttk_menu_item* item, TWindow* sub);
+
+static void sub_unlink(menu_sub* e) {
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        sub_mru = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        sub_lru = e->prev;
+    e->prev = e->next = 0;
+}
+
+static void sub_drop(menu_sub* e) {
+    sub_unlink(e);
+    sub_bytes -= e->bytes;
+    if (!e->item) sub_orphans--;
+    free(e);
+}
+
+static menu_sub* sub_find(ttk_menu_item* item) {
+    menu_sub* e;
+
+    for (e = sub_mru; e; e = e->next)
+        if (e->item == item) return e;
+    return 0;
+}
+
+static void forget_sub(ttk_menu_item* item) {
+    menu_sub* e = sub_find(item);
+    if (e) sub_drop(e);
+}
+
+static void forget_subs(TWidget* this) {
+    menu_sub *e, *next;
+
+    for (e = sub_mru; e; e = next) {
+        next = e->next;
+        if (e->menu == this) sub_drop(e);
+    }
+}
+
+// About what win holds on to: its surface, and any menu's tables and rows.
+static int window_bytes(TWindow* win) {
+    int bytes = sizeof(TWindow) +
+                (ttk_screen->w * ttk_screen->h * (win->color ? 16 : 2) + 7) / 8;
+    TWidgetList* wl;
+
+    for (wl = win->widgets; wl; wl = wl->next) {
+        bytes += sizeof(TWidget);
+        if (wl->v->draw == ttk_menu_draw) {
+            menu_data* d = wl->v->data;
+            bytes += sizeof(menu_data) +
+                     d->allocation * (sizeof(void*) + 2 * sizeof(int));
+            if (d->ring) bytes += (d->ringw * d->ringh * ttk_screen->bpp) / 8;
+        }
+    }
+    return bytes;
+}
+
+static int item_busy(ttk_menu_item* item) {
+    return !(item->sub < TTK_MENU_DESC_MAX) && window_busy(item->sub);
+}
+
+static int window_busy(TWindow* win) {
+    TWidgetList* wl;
+    int i, j;
+
+    if (win->onscreen) return 1;
+    for (wl = win->widgets; wl; wl = wl->next) {
+        menu_data* d = wl->v->data;
+
+        if (wl->v->draw != ttk_menu_draw) continue;
+        if (d->menu)
+            for (i = 0; i < d->items; i++)
+                if (item_busy(d->menu[i])) return 1;
+        if (d->pages)
+            for (i = 0; i < MENU_PAGES; i++)
+                for (j = 0; d->pages[i].first >= 0 && j < d->pages[i].n; j++)
+                    if (item_busy(d->pages[i].item + j)) return 1;
+    }
+    return 0;
+}
+
+// Puts e, holding win, first in line to be kept.
+static void sub_link(menu_sub* e, TWindow* win) {
+    e->win = win;
+    e->bytes = window_bytes(win);
+    sub_bytes += e->bytes;
+    e->next = sub_mru;
+    if (sub_mru)
+        sub_mru->prev = e;
+    else
+        sub_lru = e;
+    sub_mru = e;
+}
+
+static void sub_evict(menu_sub* e) {
+    ttk_menu_item* item = e->item;
+    TWindow* win = e->win;
+
+    sub_drop(e);
+    if (item) {
+        // where it was scrolled to, put back when it's made again
+        if (win->focus && win->focus->draw == ttk_menu_draw) {
+            menu_data* d = win->focus->data;
+            item->subtop = d->top;
+            item->subsel = d->sel;
+        }
+        if (sub_evict_hook) sub_evict_hook(item, win);
+        item->sub = 0;
+        item->flags &= ~TTK_MENU_MADESUB;
+    }
+    ttk_free_window(win);  // its own cached submenus go with it
+}
+
+// item is going away but its submenu is still up.
+static void sub_orphan(ttk_menu_item* item) {
+    menu_sub* e = sub_find(item);
+
+    if (!e) {
+        e = calloc(1, sizeof(menu_sub));
+        sub_link(e, item->sub);
+    }
+    e->item = 0;
+    e->menu = 0;
+    sub_orphans++;
+}
+
+// Frees the orphans that are down now.
+static void sub_reap(void) {
+    menu_sub *e, *prev;
+
+    for (e = sub_lru; sub_orphans && e; e = prev) {
+        prev = e->prev;
+        if (!e->item && !window_busy(e->win)) {
+            sub_evict(e);
+            prev = sub_lru;  // freeing it may have dropped others
+        }
+    }
+}
+
+static void sub_trim(menu_sub* keep) {
+    menu_sub* e = sub_lru;
+
+    while (sub_bytes > sub_budget && e) {
+        if (e != keep && !window_busy(e->win)) {
+            sub_evict(e);
+            e = sub_lru;  // freeing it may have dropped others
+        } else {
+            e = e->prev;
+        }
+    }
+}
+
+// item's submenu has just been shown.
+static void sub_shown(TWidget* this, ttk_menu_item* item) {
+    menu_sub* e;
+
+    if (!(item->flags & TTK_MENU_MADESUB) || !item->makesub ||
+        item->sub->data == 0x12345678)  // made every time anyway
+        return;
+
+    if ((e = sub_find(item))) {
+        sub_unlink(e);
+        sub_bytes -= e->bytes;
+    } else {
+        TWidget* focus = item->sub->focus;
+
+        e = calloc(1, sizeof(menu_sub));
+        e->item = item;
+        e->menu = this;
+        if ((item->subtop || item->subsel) && focus &&
+            focus->draw == ttk_menu_draw) {
+            menu_data* d = focus->data;
+            d->top = item->subtop;
+            d->sel = item->subsel;
+            move_selection(focus, 0);  // the menu may have changed since
+        }
+        item->subtop = item->subsel = 0;
+    }
+    sub_link(e, item->sub);
+    sub_trim(e);
+}
+
+void ttk_menu_set_sub_cache_size(int bytes) {
+    sub_budget = bytes;
+    sub_trim(0);
+}
+
+void ttk_menu_set_evict_hook(void (*hook)(ttk_menu_item* item,
+                                          TWindow* sub)) {
+    sub_evict_hook = hook;
+}
+
 int ttk_menu_button(TWidget* this, int button, int time) {
     _MAKETHIS;
     ttk_menu_item* item;
     TWindow* sub;
 
-    if (!data->menu || !data->items) {
+    if (!HAVE_ITEMS(data)) {
         ttk_hide_window(this->win);
         return 0;
     }
 
-    item = data->menu[data->xivi[data->top + data->sel]];
+    item = item_at(this, XI(data, data->top + data->sel));
 
     switch (button) {
         case TTK_BUTTON_ACTION:
@@ -1145,7 +2435,6 @@ int ttk_menu_button(TWidget* this, int button, int time) {
                 ++item->choice;
                 item->choice %= item->nchoices;
                 if (item->choicechanged) item->choicechanged(item, item->cdata);
-                render(this, data->top + data->sel, 1);
                 this->dirty++;
                 break;
             }
@@ -1207,6 +2496,7 @@ int ttk_menu_button(TWidget* this, int button, int time) {
                 return TTK_EV_DONE;
             } else {
                 ttk_show_window(item->sub);
+                sub_shown(this, item);
                 return TTK_EV_CLICK;
             }
         case TTK_BUTTON_MENU:
@@ -1223,6 +2513,37 @@ int ttk_menu_button(TWidget* this, int button, int time) {
 
 int ttk_menu_down(TWidget* this, int button) { return TTK_EV_UNUSED; }
 
+int ttk_menu_jump(TWidget* this, const char* prefix) {
+    _MAKETHIS;
+    int vi;
+
+    if (!HAVE_ITEMS(data) || (vi = find_prefix(this, prefix)) < 0) return 0;
+    move_selection(this, vi - (data->top + data->sel));
+    return 1;
+}
+
+// Type-ahead: characters typed within a second of each other build up a
+// prefix to jump to.
+int ttk_menu_input(TWidget* this, int ch) {
+    _MAKETHIS;
+    int len = strlen(data->typed);
+
+    if (data->ds - data->typedat > 10) len = 0;
+    data->typedat = data->ds;
+
+    if (ch == TTK_INPUT_BKSP) {
+        if (len) len--;
+    } else if (ch == TTK_INPUT_ENTER || ch == TTK_INPUT_END) {
+        len = 0;
+    } else if (ch >= ' ' && len < sizeof(data->typed) - 1) {
+        data->typed[len++] = ch;
+    }
+    data->typed[len] = 0;
+
+    if (len && ttk_menu_jump(this, data->typed)) return TTK_EV_CLICK;
+    return 0;
+}
+
 // When you free a menu, all the windows it spawned are also freed.
 // If its parent window was also a menu, it needs to be told that this one
 // doesn't exist. Thus, you probably shouldn't free menus outside of special
@@ -1231,6 +2552,7 @@ void ttk_menu_free(TWidget* this) {
     int i;
     _MAKETHIS;
 
+    forget_subs(this);
     if (data->menu) {
         for (i = 0; data->menu[i]; i++) {
             if (data->menu[i]->sub &&
@@ -1238,10 +2560,12 @@ void ttk_menu_free(TWidget* this) {
                 data->menu[i]->sub != TTK_MENU_UPONE &&
                 data->menu[i]->sub != TTK_MENU_UPALL &&
                 data->menu[i]->sub != TTK_MENU_QUIT &&
-                data->menu[i]->sub != TTK_MENU_REPLACE)
+                data->menu[i]->sub != TTK_MENU_REPLACE) {
                 ttk_free_window(data->menu[i]->sub);
-            if (data->itemsrf[i]) ttk_free_surface(data->itemsrf[i]);
-            if (data->itemsrfI[i]) ttk_free_surface(data->itemsrfI[i]);
+                // the item may outlive us, and be shown in another menu
+                data->menu[i]->sub = 0;
+                data->menu[i]->flags &= ~TTK_MENU_MADESUB;
+            }
             if (data->free_everything) {
                 if (data->menu[i]->free_data) free(data->menu[i]->data);
                 if (data->menu[i]->free_name) free((char*)data->menu[i]->name);
@@ -1250,6 +2574,19 @@ void ttk_menu_free(TWidget* this) {
         }
         free(data->menu);
     }
+    free(data->vixi);
+    free(data->xivi);
+    forget_rows(this);
+    forget_index(data);
+    free(data->keys);
+    if (data->ring) ttk_free_surface(data->ring);
+    if (data->linebuf) ttk_free_surface(data->linebuf);
+    free(data->slots);
+    if (data->pages) {
+        drop_pages(this);
+        free(data->pages);
+    }
+    if (data->list) ttk_free_menu_list(data->list);
 
     free(data);
 }
@@ -1257,19 +2594,16 @@ void ttk_menu_free(TWidget* this) {
 void ttk_menu_clear(TWidget* this) {
     int i;
     _MAKETHIS;
+    if (data->prov.fetch) return;
+    forget_rows(this);
+    forget_subs(this);
+    forget_index(data);
+    data->keyslen = data->keysdead = 0;
     if (data->menu) {
         for (i = 0; data->menu[i]; i++) {
-            if (data->menu[i]->sub && data->menu[i]->sub < TTK_MENU_DESC_MAX) {
+            if (!(data->menu[i]->sub < TTK_MENU_DESC_MAX)) {
                 ttk_free_window(data->menu[i]->sub);
             }
-            if (data->itemsrf[i]) {
-                ttk_free_surface(data->itemsrf[i]);
-                data->itemsrf[i] = 0;
-            }
-            if (data->itemsrfI[i]) {
-                ttk_free_surface(data->itemsrf[i]);
-                data->itemsrfI[i] = 0;
-            }
             if (data->free_everything && data->menu[i]->free_data)
                 free(data->menu[i]->data);
             if (data->free_everything && data->menu[i]->free_name)
@@ -1278,7 +2612,7 @@ void ttk_menu_clear(TWidget* this) {
             data->menu[i] = 0;
         }
     }
-    data->items = 0;
+    data->items = data->vitems = 0;
     data->sel = data->top = 0;
     this->dirty++;
 }
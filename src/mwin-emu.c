@@ -78,7 +78,8 @@ int t_GrGetNextEventTimeout(t_GR_EVENT* ev, int timeout) {
     int start = ttk_getticks();
     int end = start + timeout;
 
-    while (!t_GrPeekEvent(ev) && (ttk_getticks() < end));
+    while (!t_GrPeekEvent(ev) && (ttk_getticks() < end))
+        ttk_wait_event(MAX(end - ttk_getticks(), 0));
     if (ttk_getticks() < end) return 0;
     return 1;
 }
@@ -61,11 +61,44 @@ void ttk_gfx_quit() { GrClose(); }
 
 void ttk_gfx_update(ttk_surface s) { GrFlush(); }
 
+// The server already knows what we drew.
+void ttk_gfx_update_rects(ttk_surface s, int n, TRect* rects) { GrFlush(); }
+
+// An event pulled off the queue by ttk_wait_event() but not yet handed out.
+static GR_EVENT waited_ev;
+static int have_waited_ev = 0;
+
+static void next_event(GR_EVENT* ev) {
+    if (have_waited_ev) {
+        *ev = waited_ev;
+        have_waited_ev = 0;
+    } else {
+        GrCheckNextEvent(ev);
+    }
+}
+
+int ttk_gfx_wait_event(int ms) {
+    if (have_waited_ev || GrPeekEvent(&waited_ev)) return 1;
+    if (!ms) return 0;
+
+    // Nano-X treats a zero timeout as "forever".
+    if (ms < 0)
+        GrGetNextEvent(&waited_ev);
+    else
+        GrGetNextEventTimeout(&waited_ev, ms);
+
+    if (waited_ev.type == GR_EVENT_TYPE_NONE ||
+        waited_ev.type == GR_EVENT_TYPE_TIMEOUT)
+        return 0;
+    have_waited_ev = 1;
+    return 1;
+}
+
 int ttk_get_rawevent(int* arg) {
     GR_EVENT ev;
     int tev = TTK_NO_EVENT;
 
-    if (GrCheckNextEvent(&ev), ev.type != GR_EVENT_TYPE_NONE) {
+    if (next_event(&ev), ev.type != GR_EVENT_TYPE_NONE) {
         switch (ev.type) {
             case GR_EVENT_TYPE_CLOSE_REQ:
                 ttk_quit();
@@ -107,8 +140,9 @@ int ttk_get_event(int* arg) {
 
     *arg = 0;
 
-    // We amalgamate adjacent scroll events to reduce lag.
-    while (GrCheckNextEvent(&ev), ev.type != GR_EVENT_TYPE_NONE) {
+    // Scroll events are passed on one at a time; ttk_run() merges them if
+    // it falls behind.
+    while (next_event(&ev), ev.type != GR_EVENT_TYPE_NONE) {
         switch (ev.type) {
             case GR_EVENT_TYPE_CLOSE_REQ:
                 ttk_quit();
@@ -118,12 +152,8 @@ int ttk_get_event(int* arg) {
             case GR_EVENT_TYPE_KEY_UP:
                 if (ev.keystroke.ch == 'l' || ev.keystroke.ch == 'r') {
                     if (ev.type == GR_EVENT_TYPE_KEY_DOWN) continue;
-                    tev = TTK_SCROLL;
-                    if (ev.keystroke.ch == 'l')
-                        (*arg)--;
-                    else
-                        (*arg)++;
-                    break;
+                    *arg = (ev.keystroke.ch == 'r') ? 1 : -1;
+                    return TTK_SCROLL;
                 }
 
                 tev = (ev.type == GR_EVENT_TYPE_KEY_DOWN) ? TTK_BUTTON_DOWN
@@ -175,14 +205,14 @@ int ttk_get_event(int* arg) {
     return tev;
 }
 
-int ttk_getticks() {
+int ttk_gfx_getticks() {
     struct timeval tv;
     gettimeofday(&tv, 0);
     return (tv.tv_usec - tvstart.tv_usec) / 1000 +
            (tv.tv_sec - tvstart.tv_sec) * 1000;
 }
 
-void ttk_delay(int ms) {
+void ttk_gfx_delay(int ms) {
     struct timespec ts;
     ts.tv_sec = ms / 1000;
     ts.tv_nsec = (ms % 1000) * 1000000;
@@ -500,4 +530,7 @@ void ttk_surface_get_dimen(ttk_surface srf, int* w, int* h) {
     if (h) *h = winf.height;
 }
 
+// pixmaps are always copied whole
+void ttk_surface_set_opaque(ttk_surface srf) {}
+
 void ttk_free_surface(ttk_surface srf) { GrDestroyWindow(srf); }
@@ -0,0 +1,1022 @@
+/*
+ * This file is a part of TTK.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* The null backend draws into plain memory and never touches a display.
+ * It's meant for benchmarks and CI: input only arrives through
+ * ttk_replay_events(), and ttk_null_stats() reports what was presented.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "ttk.h"
+#ifdef NULLGFX
+
+extern ttk_screeninfo* ttk_screen;
+
+static struct timeval tvstart;
+static long null_frames, null_pixels;
+static char* null_dumpdir;
+
+// Built-in 6x13 font (X11 misc-fixed, public domain), ASCII 0x20-0x7E.
+// One byte per row, leftmost pixel in the high bit.
+#define GLYPH_W 6
+#define GLYPH_H 13
+static const unsigned char glyphs[95 * GLYPH_H] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // ' '
+    0x00, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x20, 0x00, 0x00,  // '!'
+    0x00, 0x00, 0x50, 0x50, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // '"'
+    0x00, 0x00, 0x00, 0x50, 0x50, 0xF8, 0x50, 0xF8, 0x50, 0x50, 0x00, 0x00, 0x00,  // '#'
+    0x00, 0x00, 0x20, 0x78, 0xA0, 0xA0, 0x70, 0x28, 0x28, 0xF0, 0x20, 0x00, 0x00,  // '$'
+    0x00, 0x00, 0x48, 0xA8, 0x50, 0x10, 0x20, 0x40, 0x50, 0xA8, 0x90, 0x00, 0x00,  // '%'
+    0x00, 0x00, 0x40, 0xA0, 0xA0, 0x40, 0xA0, 0x98, 0x90, 0x68, 0x00, 0x00, 0x00,  // '&'
+    0x00, 0x00, 0x30, 0x20, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // "'"
+    0x00, 0x00, 0x10, 0x20, 0x20, 0x40, 0x40, 0x40, 0x20, 0x20, 0x10, 0x00, 0x00,  // '('
+    0x00, 0x00, 0x40, 0x20, 0x20, 0x10, 0x10, 0x10, 0x20, 0x20, 0x40, 0x00, 0x00,  // ')'
+    0x00, 0x00, 0x00, 0x20, 0xA8, 0xF8, 0x70, 0xF8, 0xA8, 0x20, 0x00, 0x00, 0x00,  // '*'
+    0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0xF8, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00,  // '+'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x20, 0x40, 0x00,  // ','
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // '-'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x70, 0x20, 0x00,  // '.'
+    0x00, 0x00, 0x08, 0x08, 0x10, 0x10, 0x20, 0x40, 0x40, 0x80, 0x80, 0x00, 0x00,  // '/'
+    0x00, 0x00, 0x20, 0x50, 0x88, 0x88, 0x88, 0x88, 0x88, 0x50, 0x20, 0x00, 0x00,  // '0'
+    0x00, 0x00, 0x20, 0x60, 0xA0, 0x20, 0x20, 0x20, 0x20, 0x20, 0xF8, 0x00, 0x00,  // '1'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x08, 0x10, 0x20, 0x40, 0x80, 0xF8, 0x00, 0x00,  // '2'
+    0x00, 0x00, 0xF8, 0x08, 0x10, 0x20, 0x70, 0x08, 0x08, 0x88, 0x70, 0x00, 0x00,  // '3'
+    0x00, 0x00, 0x10, 0x10, 0x30, 0x50, 0x50, 0x90, 0xF8, 0x10, 0x10, 0x00, 0x00,  // '4'
+    0x00, 0x00, 0xF8, 0x80, 0x80, 0xB0, 0xC8, 0x08, 0x08, 0x88, 0x70, 0x00, 0x00,  // '5'
+    0x00, 0x00, 0x70, 0x88, 0x80, 0x80, 0xF0, 0x88, 0x88, 0x88, 0x70, 0x00, 0x00,  // '6'
+    0x00, 0x00, 0xF8, 0x08, 0x10, 0x10, 0x20, 0x20, 0x40, 0x40, 0x40, 0x00, 0x00,  // '7'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x70, 0x88, 0x88, 0x88, 0x70, 0x00, 0x00,  // '8'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x78, 0x08, 0x08, 0x88, 0x70, 0x00, 0x00,  // '9'
+    0x00, 0x00, 0x00, 0x00, 0x20, 0x70, 0x20, 0x00, 0x00, 0x20, 0x70, 0x20, 0x00,  // ':'
+    0x00, 0x00, 0x00, 0x00, 0x20, 0x70, 0x20, 0x00, 0x00, 0x30, 0x20, 0x40, 0x00,  // ';'
+    0x00, 0x00, 0x08, 0x10, 0x20, 0x40, 0x80, 0x40, 0x20, 0x10, 0x08, 0x00, 0x00,  // '<'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00, 0x00, 0xF8, 0x00, 0x00, 0x00, 0x00,  // '='
+    0x00, 0x00, 0x80, 0x40, 0x20, 0x10, 0x08, 0x10, 0x20, 0x40, 0x80, 0x00, 0x00,  // '>'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x08, 0x10, 0x20, 0x20, 0x00, 0x20, 0x00, 0x00,  // '?'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x98, 0xA8, 0xA8, 0xB0, 0x80, 0x78, 0x00, 0x00,  // '@'
+    0x00, 0x00, 0x20, 0x50, 0x88, 0x88, 0x88, 0xF8, 0x88, 0x88, 0x88, 0x00, 0x00,  // 'A'
+    0x00, 0x00, 0xF0, 0x48, 0x48, 0x48, 0x70, 0x48, 0x48, 0x48, 0xF0, 0x00, 0x00,  // 'B'
+    0x00, 0x00, 0x70, 0x88, 0x80, 0x80, 0x80, 0x80, 0x80, 0x88, 0x70, 0x00, 0x00,  // 'C'
+    0x00, 0x00, 0xF0, 0x48, 0x48, 0x48, 0x48, 0x48, 0x48, 0x48, 0xF0, 0x00, 0x00,  // 'D'
+    0x00, 0x00, 0xF8, 0x80, 0x80, 0x80, 0xF0, 0x80, 0x80, 0x80, 0xF8, 0x00, 0x00,  // 'E'
+    0x00, 0x00, 0xF8, 0x80, 0x80, 0x80, 0xF0, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00,  // 'F'
+    0x00, 0x00, 0x70, 0x88, 0x80, 0x80, 0x80, 0x98, 0x88, 0x88, 0x70, 0x00, 0x00,  // 'G'
+    0x00, 0x00, 0x88, 0x88, 0x88, 0x88, 0xF8, 0x88, 0x88, 0x88, 0x88, 0x00, 0x00,  // 'H'
+    0x00, 0x00, 0x70, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00, 0x00,  // 'I'
+    0x00, 0x00, 0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x90, 0x60, 0x00, 0x00,  // 'J'
+    0x00, 0x00, 0x88, 0x88, 0x90, 0xA0, 0xC0, 0xA0, 0x90, 0x88, 0x88, 0x00, 0x00,  // 'K'
+    0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0xF8, 0x00, 0x00,  // 'L'
+    0x00, 0x00, 0x88, 0x88, 0xD8, 0xA8, 0xA8, 0x88, 0x88, 0x88, 0x88, 0x00, 0x00,  // 'M'
+    0x00, 0x00, 0x88, 0xC8, 0xC8, 0xA8, 0xA8, 0x98, 0x98, 0x88, 0x88, 0x00, 0x00,  // 'N'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x70, 0x00, 0x00,  // 'O'
+    0x00, 0x00, 0xF0, 0x88, 0x88, 0x88, 0xF0, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00,  // 'P'
+    0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0xA8, 0x70, 0x08, 0x00,  // 'Q'
+    0x00, 0x00, 0xF0, 0x88, 0x88, 0x88, 0xF0, 0xA0, 0x90, 0x88, 0x88, 0x00, 0x00,  // 'R'
+    0x00, 0x00, 0x70, 0x88, 0x80, 0x80, 0x70, 0x08, 0x08, 0x88, 0x70, 0x00, 0x00,  // 'S'
+    0x00, 0x00, 0xF8, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00,  // 'T'
+    0x00, 0x00, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x70, 0x00, 0x00,  // 'U'
+    0x00, 0x00, 0x88, 0x88, 0x88, 0x88, 0x50, 0x50, 0x50, 0x20, 0x20, 0x00, 0x00,  // 'V'
+    0x00, 0x00, 0x88, 0x88, 0x88, 0x88, 0xA8, 0xA8, 0xA8, 0xD8, 0x88, 0x00, 0x00,  // 'W'
+    0x00, 0x00, 0x88, 0x88, 0x50, 0x50, 0x20, 0x50, 0x50, 0x88, 0x88, 0x00, 0x00,  // 'X'
+    0x00, 0x00, 0x88, 0x88, 0x50, 0x50, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00,  // 'Y'
+    0x00, 0x00, 0xF8, 0x08, 0x10, 0x10, 0x20, 0x40, 0x40, 0x80, 0xF8, 0x00, 0x00,  // 'Z'
+    0x00, 0x00, 0x70, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x70, 0x00, 0x00,  // '['
+    0x00, 0x00, 0x80, 0x80, 0x40, 0x40, 0x20, 0x10, 0x10, 0x08, 0x08, 0x00, 0x00,  // '\\'
+    0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x70, 0x00, 0x00,  // ']'
+    0x00, 0x00, 0x20, 0x50, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // '^'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x00,  // '_'
+    0x00, 0x00, 0x30, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // '`'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x08, 0x78, 0x88, 0x88, 0x78, 0x00, 0x00,  // 'a'
+    0x00, 0x00, 0x80, 0x80, 0x80, 0xF0, 0x88, 0x88, 0x88, 0x88, 0xF0, 0x00, 0x00,  // 'b'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x88, 0x80, 0x80, 0x88, 0x70, 0x00, 0x00,  // 'c'
+    0x00, 0x00, 0x08, 0x08, 0x08, 0x78, 0x88, 0x88, 0x88, 0x88, 0x78, 0x00, 0x00,  // 'd'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x88, 0xF8, 0x80, 0x88, 0x70, 0x00, 0x00,  // 'e'
+    0x00, 0x00, 0x30, 0x48, 0x40, 0x40, 0xF0, 0x40, 0x40, 0x40, 0x40, 0x00, 0x00,  // 'f'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x78, 0x08, 0x88, 0x70,  // 'g'
+    0x00, 0x00, 0x80, 0x80, 0x80, 0xB0, 0xC8, 0x88, 0x88, 0x88, 0x88, 0x00, 0x00,  // 'h'
+    0x00, 0x00, 0x00, 0x20, 0x00, 0x60, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00, 0x00,  // 'i'
+    0x00, 0x00, 0x00, 0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x10, 0x90, 0x90, 0x60,  // 'j'
+    0x00, 0x00, 0x80, 0x80, 0x80, 0x90, 0xA0, 0xC0, 0xA0, 0x90, 0x88, 0x00, 0x00,  // 'k'
+    0x00, 0x00, 0x60, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x70, 0x00, 0x00,  // 'l'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0xA8, 0xA8, 0xA8, 0xA8, 0x88, 0x00, 0x00,  // 'm'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0xC8, 0x88, 0x88, 0x88, 0x88, 0x00, 0x00,  // 'n'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x88, 0x88, 0x88, 0x88, 0x70, 0x00, 0x00,  // 'o'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x88, 0x88, 0x88, 0xF0, 0x80, 0x80, 0x80,  // 'p'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x78, 0x88, 0x88, 0x88, 0x78, 0x08, 0x08, 0x08,  // 'q'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xB0, 0xC8, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00,  // 'r'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x88, 0x60, 0x10, 0x88, 0x70, 0x00, 0x00,  // 's'
+    0x00, 0x00, 0x00, 0x40, 0x40, 0xF0, 0x40, 0x40, 0x40, 0x48, 0x30, 0x00, 0x00,  // 't'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x88, 0x88, 0x88, 0x98, 0x68, 0x00, 0x00,  // 'u'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x88, 0x88, 0x50, 0x50, 0x20, 0x00, 0x00,  // 'v'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x88, 0xA8, 0xA8, 0xA8, 0x50, 0x00, 0x00,  // 'w'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x50, 0x20, 0x20, 0x50, 0x88, 0x00, 0x00,  // 'x'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0x88, 0x88, 0x98, 0x68, 0x08, 0x88, 0x70,  // 'y'
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x10, 0x20, 0x40, 0x80, 0xF8, 0x00, 0x00,  // 'z'
+    0x00, 0x00, 0x18, 0x20, 0x20, 0x20, 0xC0, 0x20, 0x20, 0x20, 0x18, 0x00, 0x00,  // '{'
+    0x00, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00,  // '|'
+    0x00, 0x00, 0xC0, 0x20, 0x20, 0x20, 0x18, 0x20, 0x20, 0x20, 0xC0, 0x00, 0x00,  // '}'
+    0x00, 0x00, 0x48, 0xA8, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // '~'
+};
+
+#define BYTESPP(s) ((s)->bpp == 2 ? 1 : (s)->bpp / 8)
+#define ROW(s, y) ((s)->pixels + (y) * (s)->pitch)
+
+static ttk_surface alloc_surface(int w, int h, int bpp) {
+    ttk_surface ret = calloc(1, sizeof(struct _ttk_surface));
+
+    if (bpp != 2 && bpp != 16) bpp = 32;
+    if (ret) {
+        ret->w = w;
+        ret->h = h;
+        ret->bpp = bpp;
+        ret->pitch = w * BYTESPP(ret);
+        ret->pixels = calloc(1, ret->pitch * h + 1);
+    }
+    if (!ret || !ret->pixels) {
+        fprintf(stderr, "ttk_new_surface(null): out of memory\n");
+        abort();
+    }
+    return ret;
+}
+
+void ttk_gfx_init() {
+    gettimeofday(&tvstart, 0);
+    ttk_screen->srf = alloc_surface(ttk_screen->w, ttk_screen->h,
+                                    ttk_screen->bpp);
+}
+
+void ttk_gfx_quit() {
+    free(ttk_screen->srf->pixels);
+    free(ttk_screen->srf);
+    ttk_screen->srf = 0;
+}
+
+static void dump_frame(ttk_surface srf) {
+    static long n;
+    char fname[1024];
+    FILE* fp;
+    int x, y, r, g, b;
+
+    snprintf(fname, sizeof(fname), "%s/frame%05ld.%s", null_dumpdir, n++,
+             (srf->bpp == 2) ? "pgm" : "ppm");
+    if (!(fp = fopen(fname, "wb"))) {
+        perror(fname);
+        return;
+    }
+    fprintf(fp, "P%c\n%d %d\n255\n", (srf->bpp == 2) ? '5' : '6', srf->w,
+            srf->h);
+    for (y = 0; y < srf->h; y++) {
+        for (x = 0; x < srf->w; x++) {
+            ttk_unmakecol_ex(ttk_getpixel(srf, x, y), &r, &g, &b, srf);
+            if (srf->bpp == 2) {
+                putc(r, fp);
+            } else {
+                putc(r, fp);
+                putc(g, fp);
+                putc(b, fp);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+void ttk_gfx_update(ttk_surface srf) {
+    null_frames++;
+    null_pixels += srf->w * srf->h;
+    if (null_dumpdir) dump_frame(srf);
+}
+
+void ttk_gfx_update_rects(ttk_surface srf, int n, TRect* rects) {
+    int i;
+
+    null_frames++;
+    for (i = 0; i < n; i++) null_pixels += rects[i].w * rects[i].h;
+    if (null_dumpdir) dump_frame(srf);
+}
+
+void ttk_null_stats(long* frames, long* pixels) {
+    if (frames) *frames = null_frames;
+    if (pixels) *pixels = null_pixels;
+}
+
+void ttk_null_dump_frames(const char* dir) {
+    free(null_dumpdir);
+    null_dumpdir = dir ? strdup(dir) : 0;
+}
+
+// There's no input device; events come from ttk_replay_events().
+int ttk_get_rawevent(int* arg) { return TTK_NO_EVENT; }
+int ttk_get_event(int* arg) { return TTK_NO_EVENT; }
+
+int ttk_gfx_wait_event(int ms) {
+    // Nothing can wake us early, so "forever" is a nap and a recheck.
+    ttk_gfx_delay((ms < 0) ? 100 : ms);
+    return 0;
+}
+
+int ttk_gfx_getticks() {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return (tv.tv_usec - tvstart.tv_usec) / 1000 +
+           (tv.tv_sec - tvstart.tv_sec) * 1000;
+}
+
+void ttk_gfx_delay(int ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+#ifndef MAX
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+#endif
+
+static int surface_bpp(ttk_surface srf) {
+    if (!srf) srf = ttk_screen->srf;
+    if (srf) return srf->bpp;
+    return (ttk_screen->bpp == 2 || ttk_screen->bpp == 16) ? ttk_screen->bpp
+                                                           : 32;
+}
+
+ttk_color ttk_makecol(int r, int g, int b) {
+    return ttk_makecol_ex(r, g, b, 0);
+}
+
+ttk_color ttk_makecol_ex(int r, int g, int b, ttk_surface srf) {
+    int hue;
+
+    switch (surface_bpp(srf)) {
+        case 2:
+            // same grey levels as the SDL backend
+            if ((r + g + b) == 0) return 3;
+            if ((r + g + b) == 3 * 255) return 0;
+
+            hue = MAX(MAX(r, g), b);
+            if (hue < 40) return 3;
+            if (hue < 120) return 2;
+            if (hue < 200) return 1;
+            return 0;
+        case 16:
+            return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | ((b & 0xff) >> 3);
+        default:
+            return ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
+    }
+}
+
+void ttk_unmakecol(ttk_color col, int* r, int* g, int* b) {
+    ttk_unmakecol_ex(col, r, g, b, 0);
+}
+void ttk_unmakecol_ex(ttk_color col, int* r, int* g, int* b, ttk_surface srf) {
+    switch (surface_bpp(srf)) {
+        case 2:
+            col &= 3;
+            *r = *g = *b = (col == 3) ? 0 : (col == 2) ? 80 : (col == 1) ? 160 : 255;
+            break;
+        case 16:
+            *r = ((col >> 11) & 0x1f) * 255 / 31;
+            *g = ((col >> 5) & 0x3f) * 255 / 63;
+            *b = (col & 0x1f) * 255 / 31;
+            break;
+        default:
+            *r = (col >> 16) & 0xff;
+            *g = (col >> 8) & 0xff;
+            *b = col & 0xff;
+            break;
+    }
+}
+
+ttk_gc ttk_new_gc() { return (ttk_gc)calloc(1, sizeof(struct _ttk_gc)); }
+ttk_gc ttk_copy_gc(ttk_gc other) {
+    ttk_gc ret = malloc(sizeof(struct _ttk_gc));
+    memcpy(ret, other, sizeof(struct _ttk_gc));
+    return ret;
+}
+ttk_color ttk_gc_get_foreground(ttk_gc gc) { return gc->fg; }
+ttk_color ttk_gc_get_background(ttk_gc gc) { return gc->bg; }
+ttk_font ttk_gc_get_font(ttk_gc gc) { return gc->font; }
+void ttk_gc_set_foreground(ttk_gc gc, ttk_color fgcol) { gc->fg = fgcol; }
+void ttk_gc_set_background(ttk_gc gc, ttk_color bgcol) { gc->bg = bgcol; }
+void ttk_gc_set_font(ttk_gc gc, ttk_font font) { gc->font = font; }
+void ttk_gc_set_usebg(ttk_gc gc, int flag) { gc->usebg = flag; }
+void ttk_gc_set_xormode(ttk_gc gc, int flag) { gc->xormode = flag; }
+void ttk_free_gc(ttk_gc gc) { free(gc); }
+
+// Unclipped store; callers check bounds.
+static inline void put(ttk_surface srf, int x, int y, ttk_color col) {
+    unsigned char* p = ROW(srf, y);
+    switch (srf->bpp) {
+        case 2:
+            p[x] = col;
+            break;
+        case 16:
+            ((unsigned short*)p)[x] = col;
+            break;
+        default:
+            ((unsigned int*)p)[x] = col;
+            break;
+    }
+}
+
+// Inclusive horizontal span, clipped.
+static void span(ttk_surface srf, int x1, int x2, int y, ttk_color col) {
+    unsigned char* p;
+    int t;
+
+    if (x1 > x2) t = x1, x1 = x2, x2 = t;
+    if (y < 0 || y >= srf->h || x2 < 0 || x1 >= srf->w) return;
+    if (x1 < 0) x1 = 0;
+    if (x2 >= srf->w) x2 = srf->w - 1;
+
+    p = ROW(srf, y);
+    switch (srf->bpp) {
+        case 2:
+            memset(p + x1, col, x2 - x1 + 1);
+            break;
+        case 16: {
+            unsigned short* q = (unsigned short*)p + x1;
+            t = x2 - x1 + 1;
+            while (t--) *q++ = col;
+            break;
+        }
+        default: {
+            unsigned int* q = (unsigned int*)p + x1;
+            t = x2 - x1 + 1;
+            while (t--) *q++ = col;
+            break;
+        }
+    }
+}
+
+ttk_color ttk_getpixel(ttk_surface srf, int x, int y) {
+    unsigned char* p;
+
+    if (x < 0 || y < 0 || x >= srf->w || y >= srf->h)
+        return ttk_makecol_ex(255, 0, 255, srf);
+    p = ROW(srf, y);
+    switch (srf->bpp) {
+        case 2:
+            return p[x];
+        case 16:
+            return ((unsigned short*)p)[x];
+        default:
+            return ((unsigned int*)p)[x];
+    }
+}
+void ttk_pixel(ttk_surface srf, int x, int y, ttk_color col) {
+    if (x >= 0 && y >= 0 && x < srf->w && y < srf->h) put(srf, x, y, col);
+}
+void ttk_pixel_gc(ttk_surface srf, ttk_gc gc, int x, int y) {
+    ttk_pixel(srf, x, y, gc->fg);
+}
+
+void ttk_line(ttk_surface srf, int x1, int y1, int x2, int y2, ttk_color col) {
+    int dx, dy, sx, sy, err, e2;
+
+    if (y1 == y2) {
+        span(srf, x1, x2, y1, col);
+        return;
+    }
+    if (x1 == x2) {
+        if (x1 < 0 || x1 >= srf->w) return;
+        if (y1 > y2) sy = y1, y1 = y2, y2 = sy;
+        if (y1 < 0) y1 = 0;
+        if (y2 >= srf->h) y2 = srf->h - 1;
+        for (; y1 <= y2; y1++) put(srf, x1, y1, col);
+        return;
+    }
+
+    dx = abs(x2 - x1);
+    dy = -abs(y2 - y1);
+    sx = (x1 < x2) ? 1 : -1;
+    sy = (y1 < y2) ? 1 : -1;
+    err = dx + dy;
+    for (;;) {
+        ttk_pixel(srf, x1, y1, col);
+        if (x1 == x2 && y1 == y2) break;
+        e2 = 2 * err;
+        if (e2 >= dy) err += dy, x1 += sx;
+        if (e2 <= dx) err += dx, y1 += sy;
+    }
+}
+void ttk_line_gc(ttk_surface srf, ttk_gc gc, int x1, int y1, int x2, int y2) {
+    ttk_line(srf, x1, y1, x2, y2, gc->fg);
+}
+void ttk_aaline(ttk_surface srf, int x1, int y1, int x2, int y2,
+                ttk_color col) {
+    ttk_line(srf, x1, y1, x2, y2, col);
+}
+void ttk_aaline_gc(ttk_surface srf, ttk_gc gc, int x1, int y1, int x2, int y2) {
+    ttk_line(srf, x1, y1, x2, y2, gc->fg);
+}
+
+void ttk_rect(ttk_surface srf, int x1, int y1, int x2, int y2, ttk_color col) {
+    ttk_line(srf, x1, y1, x2, y1, col);
+    ttk_line(srf, x1, y2, x2, y2, col);
+    ttk_line(srf, x1, y1, x1, y2, col);
+    ttk_line(srf, x2, y1, x2, y2, col);
+}
+void ttk_rect_gc(ttk_surface srf, ttk_gc gc, int x, int y, int w, int h) {
+    ttk_rect(srf, x, y, x + w, y + h, gc->fg);
+}
+void ttk_fillrect(ttk_surface srf, int x1, int y1, int x2, int y2,
+                  ttk_color col) {
+    int t;
+
+    if (y1 > y2) t = y1, y1 = y2, y2 = t;
+    if (y1 < 0) y1 = 0;
+    if (y2 >= srf->h) y2 = srf->h - 1;
+    for (; y1 <= y2; y1++) span(srf, x1, x2, y1, col);
+}
+void ttk_fillrect_gc(ttk_surface srf, ttk_gc gc, int x, int y, int w, int h) {
+    if (gc->xormode) {
+        // Like the SDL backend: columns [x, x+w), rows [y, y+h].
+        ttk_color mask = (srf->bpp == 2) ? 0xff : (srf->bpp == 16) ? 0xffff
+                                                                   : 0xffffff;
+        int x1 = MAX(x, 0), x2 = x + w, y1 = MAX(y, 0), y2 = y + h, i;
+
+        if (x2 > srf->w) x2 = srf->w;
+        if (y2 >= srf->h) y2 = srf->h - 1;
+        for (; y1 <= y2; y1++)
+            for (i = x1; i < x2; i++)
+                put(srf, i, y1, ttk_getpixel(srf, i, y1) ^ mask);
+    } else {
+        ttk_fillrect(srf, x, y, x + w, y + h, gc->fg);
+    }
+}
+
+extern unsigned char ttk_chamfering[][10];
+
+void ttk_do_gradient(ttk_surface srf, char horiz, int b_rad, int e_rad, int x1,
+                     int y1, int x2, int y2, ttk_color begin, ttk_color end) {
+    gradient_node* gn = ttk_gradient_find_or_add(begin, end);
+    int steps = horiz ? x2 - x1 : y2 - y1;
+    int line, bc, ec, i;
+
+    if (!gn) return;
+
+    if (steps < 0) steps *= -1;
+
+    if (horiz) {
+        for (line = 0, i = steps; line < i && (b_rad || e_rad); line++, i--) {
+            bc = (line < b_rad) ? ttk_chamfering[b_rad - 1][line] : 0;
+            ec = (line < e_rad) ? ttk_chamfering[e_rad - 1][line] : 0;
+            if (bc == 0 && ec == 0) break;
+            ttk_line(srf, x1 + line, y1 + bc, x1 + line, y2 - 1 - bc,
+                     gn->gradient[(line * 256) / steps]);
+            ttk_line(srf, x2 - 1 - line, y1 + ec, x2 - 1 - line, y2 - 1 - ec,
+                     gn->gradient[((i - 1) * 256) / steps]);
+        }
+        for (; line < i; line++) {
+            ttk_line(srf, x1 + line, y1, x1 + line, y2 - 1,
+                     gn->gradient[(line * 256) / steps]);
+        }
+    } else {
+        for (line = 0, i = steps; line < i && (b_rad || e_rad); line++, i--) {
+            bc = (line < b_rad) ? ttk_chamfering[b_rad - 1][line] : 0;
+            ec = (line < e_rad) ? ttk_chamfering[e_rad - 1][line] : 0;
+            if (bc == 0 && ec == 0) break;
+            span(srf, x1 + bc, x2 - 1 - bc, y1 + line,
+                 gn->gradient[(line * 256) / steps]);
+            span(srf, x1 + ec, x2 - 1 - ec, y2 - 1 - line,
+                 gn->gradient[((i - 1) * 256) / steps]);
+        }
+        for (; line < i; line++)
+            span(srf, x1, x2 - 1, y1 + line,
+                 gn->gradient[(line * 256) / steps]);
+    }
+}
+
+void ttk_hgradient(ttk_surface srf, int x1, int y1, int x2, int y2,
+                   ttk_color left, ttk_color right) {
+    ttk_do_gradient(srf, 1, 0, 0, x1, y1, x2, y2, left, right);
+}
+
+void ttk_vgradient(ttk_surface srf, int x1, int y1, int x2, int y2,
+                   ttk_color top, ttk_color bottom) {
+    ttk_do_gradient(srf, 0, 0, 0, x1, y1, x2, y2, top, bottom);
+}
+
+void ttk_poly(ttk_surface srf, int nv, short* vx, short* vy, ttk_color col) {
+    int i;
+    for (i = 0; i < nv; i++)
+        ttk_line(srf, vx[i], vy[i], vx[(i + 1) % nv], vy[(i + 1) % nv], col);
+}
+void ttk_poly_pt(ttk_surface srf, ttk_point* v, int n, ttk_color col) {
+    int i;
+    for (i = 0; i < n; i++)
+        ttk_line(srf, v[i].x, v[i].y, v[(i + 1) % n].x, v[(i + 1) % n].y, col);
+}
+void ttk_poly_gc(ttk_surface srf, ttk_gc gc, int n, ttk_point* v) {
+    ttk_poly_pt(srf, v, n, gc->fg);
+}
+void ttk_aapoly(ttk_surface srf, int nv, short* vx, short* vy, ttk_color col) {
+    ttk_poly(srf, nv, vx, vy, col);
+}
+void ttk_aapoly_pt(ttk_surface srf, ttk_point* v, int n, ttk_color col) {
+    ttk_poly_pt(srf, v, n, col);
+}
+void ttk_aapoly_gc(ttk_surface srf, ttk_gc gc, int n, ttk_point* v) {
+    ttk_poly_pt(srf, v, n, gc->fg);
+}
+
+void ttk_polyline(ttk_surface srf, int nv, short* vx, short* vy,
+                  ttk_color col) {
+    int i;
+    for (i = 0; i < nv - 1; i++)
+        ttk_line(srf, vx[i], vy[i], vx[i + 1], vy[i + 1], col);
+}
+void ttk_polyline_pt(ttk_surface srf, ttk_point* v, int n, ttk_color col) {
+    int i;
+    for (i = 0; i < n - 1; i++)
+        ttk_line(srf, v[i].x, v[i].y, v[i + 1].x, v[i + 1].y, col);
+}
+void ttk_polyline_gc(ttk_surface srf, ttk_gc gc, int n, ttk_point* v) {
+    ttk_polyline_pt(srf, v, n, gc->fg);
+}
+
+// Even-odd scanline fill; the outline is drawn too so the edges are
+// inclusive like SDL_gfx's.
+void ttk_fillpoly(ttk_surface srf, int nv, short* vx, short* vy,
+                  ttk_color col) {
+    int miny, maxy, y, i, j, n, t;
+    int* xs;
+
+    if (nv < 3) return;
+    if (!(xs = malloc(nv * sizeof(int)))) return;
+
+    miny = maxy = vy[0];
+    for (i = 1; i < nv; i++) {
+        if (vy[i] < miny) miny = vy[i];
+        if (vy[i] > maxy) maxy = vy[i];
+    }
+    if (miny < 0) miny = 0;
+    if (maxy >= srf->h) maxy = srf->h - 1;
+
+    for (y = miny; y <= maxy; y++) {
+        n = 0;
+        for (i = 0, j = nv - 1; i < nv; j = i++) {
+            int xa = vx[j], ya = vy[j], xb = vx[i], yb = vy[i];
+            if (ya == yb) continue;
+            if (ya > yb) {
+                t = xa, xa = xb, xb = t;
+                t = ya, ya = yb, yb = t;
+            }
+            if (y < ya || y >= yb) continue;
+            xs[n++] = xa + (y - ya) * (xb - xa) / (yb - ya);
+        }
+        for (i = 1; i < n; i++)
+            for (j = i; j > 0 && xs[j - 1] > xs[j]; j--)
+                t = xs[j], xs[j] = xs[j - 1], xs[j - 1] = t;
+        for (i = 0; i + 1 < n; i += 2) span(srf, xs[i], xs[i + 1], y, col);
+    }
+    free(xs);
+    ttk_poly(srf, nv, vx, vy, col);
+}
+void ttk_fillpoly_pt(ttk_surface srf, ttk_point* v, int n, ttk_color col) {
+    int i;
+    short *vx = malloc(n * sizeof(short)), *vy = malloc(n * sizeof(short));
+    if (!vx || !vy) {
+        fprintf(stderr, "Out of memory\n");
+        ttk_quit();
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        vx[i] = v[i].x;
+        vy[i] = v[i].y;
+    }
+    ttk_fillpoly(srf, n, vx, vy, col);
+    free(vx);
+    free(vy);
+}
+void ttk_fillpoly_gc(ttk_surface srf, ttk_gc gc, int n, ttk_point* v) {
+    ttk_fillpoly_pt(srf, v, n, gc->fg);
+}
+
+// Midpoint ellipse; with fill set, each pair of points becomes a span.
+static void do_ellipse(ttk_surface srf, int xc, int yc, int rx, int ry,
+                       ttk_color col, int fill) {
+    long rx2 = (long)rx * rx, ry2 = (long)ry * ry;
+    long x = 0, y = ry, px = 0, py = 2 * rx2 * ry, p;
+
+    if (rx <= 0 || ry <= 0) {
+        ttk_line(srf, xc - rx, yc - ry, xc + rx, yc + ry, col);
+        return;
+    }
+
+#define PLOT4                                             \
+    do {                                                  \
+        if (fill) {                                       \
+            span(srf, xc - x, xc + x, yc - y, col);       \
+            span(srf, xc - x, xc + x, yc + y, col);       \
+        } else {                                          \
+            ttk_pixel(srf, xc - x, yc - y, col);          \
+            ttk_pixel(srf, xc + x, yc - y, col);          \
+            ttk_pixel(srf, xc - x, yc + y, col);          \
+            ttk_pixel(srf, xc + x, yc + y, col);          \
+        }                                                 \
+    } while (0)
+
+    p = ry2 - rx2 * ry + rx2 / 4;
+    while (px < py) {
+        PLOT4;
+        x++;
+        px += 2 * ry2;
+        if (p < 0) {
+            p += ry2 + px;
+        } else {
+            y--;
+            py -= 2 * rx2;
+            p += ry2 + px - py;
+        }
+    }
+    p = (ry2 * (2 * x + 1) * (2 * x + 1)) / 4 + rx2 * (y - 1) * (y - 1) -
+        rx2 * ry2;
+    while (y >= 0) {
+        PLOT4;
+        y--;
+        py -= 2 * rx2;
+        if (p > 0) {
+            p += rx2 - py;
+        } else {
+            x++;
+            px += 2 * ry2;
+            p += rx2 - py + px;
+        }
+    }
+#undef PLOT4
+}
+
+void ttk_ellipse(ttk_surface srf, int x, int y, int rx, int ry, ttk_color col) {
+    do_ellipse(srf, x, y, rx, ry, col, 0);
+}
+void ttk_ellipse_gc(ttk_surface srf, ttk_gc gc, int x, int y, int rx, int ry) {
+    do_ellipse(srf, x, y, rx, ry, gc->fg, 0);
+}
+void ttk_aaellipse(ttk_surface srf, int x, int y, int rx, int ry,
+                   ttk_color col) {
+    do_ellipse(srf, x, y, rx, ry, col, 0);
+}
+void ttk_aaellipse_gc(ttk_surface srf, ttk_gc gc, int x, int y, int rx,
+                      int ry) {
+    do_ellipse(srf, x, y, rx, ry, gc->fg, 0);
+}
+void ttk_fillellipse(ttk_surface srf, int x, int y, int rx, int ry,
+                     ttk_color col) {
+    do_ellipse(srf, x, y, rx, ry, col, 1);
+}
+void ttk_fillellipse_gc(ttk_surface srf, ttk_gc gc, int x, int y, int rx,
+                        int ry) {
+    do_ellipse(srf, x, y, rx, ry, gc->fg, 1);
+}
+void ttk_aafillellipse(ttk_surface srf, int xc, int yc, int rx, int ry,
+                       ttk_color col) {
+    do_ellipse(srf, xc, yc, rx, ry, col, 1);
+}
+void ttk_aafillellipse_gc(ttk_surface srf, ttk_gc gc, int xc, int yc, int rx,
+                          int ry) {
+    do_ellipse(srf, xc, yc, rx, ry, gc->fg, 1);
+}
+
+// Cubic bezier by forward differencing, 2^level segments.
+void ttk_bezier(ttk_surface srf, int x1, int y1, int x2, int y2, int x3, int y3,
+                int x4, int y4, int level, ttk_color col) {
+    float x = x1, y = y1, delta, dx, d2x, d3x, dy, d2y, d3y, a, b, c;
+    int i, n = 1, xp = x1, yp = y1;
+
+    if (level < 1) level = 1;
+    if (level >= 15) level = 15;
+    while (level-- > 0) n *= 2;
+    delta = 1.0f / n;
+
+    a = -x1 + 3 * x2 - 3 * x3 + x4;
+    b = 3 * x1 - 6 * x2 + 3 * x3;
+    c = -3 * x1 + 3 * x2;
+    d3x = 6 * a * delta * delta * delta;
+    d2x = d3x + 2 * b * delta * delta;
+    dx = a * delta * delta * delta + b * delta * delta + c * delta;
+
+    a = -y1 + 3 * y2 - 3 * y3 + y4;
+    b = 3 * y1 - 6 * y2 + 3 * y3;
+    c = -3 * y1 + 3 * y2;
+    d3y = 6 * a * delta * delta * delta;
+    d2y = d3y + 2 * b * delta * delta;
+    dy = a * delta * delta * delta + b * delta * delta + c * delta;
+
+    for (i = 0; i < n; i++) {
+        x += dx;
+        dx += d2x;
+        d2x += d3x;
+        y += dy;
+        dy += d2y;
+        d2y += d3y;
+        if (xp != (int)x || yp != (int)y) {
+            ttk_line(srf, xp, yp, (int)x, (int)y, col);
+            xp = x;
+            yp = y;
+        }
+    }
+}
+void ttk_bezier_gc(ttk_surface srf, ttk_gc gc, int x1, int y1, int x2, int y2,
+                   int x3, int y3, int x4, int y4, int level) {
+    ttk_bezier(srf, x1, y1, x2, y2, x3, y3, x4, y4, level, gc->fg);
+}
+void ttk_aabezier(ttk_surface srf, int x1, int y1, int x2, int y2, int x3,
+                  int y3, int x4, int y4, int level, ttk_color col) {
+    ttk_bezier(srf, x1, y1, x2, y2, x3, y3, x4, y4, level, col);
+}
+void ttk_aabezier_gc(ttk_surface srf, ttk_gc gc, int x1, int y1, int x2, int y2,
+                     int x3, int y3, int x4, int y4, int level) {
+    ttk_bezier(srf, x1, y1, x2, y2, x3, y3, x4, y4, level, gc->fg);
+}
+
+void ttk_bitmap(ttk_surface srf, int x, int y, int w, int h,
+                unsigned short* imagebits, ttk_color col) {
+    int i, j;
+    unsigned short bits = 0;
+
+    for (j = 0; j < h; j++) {
+        for (i = 0; i < w; i++) {
+            if (!(i & 15)) bits = *imagebits++;
+            if (bits & 0x8000) ttk_pixel(srf, x + i, y + j, col);
+            bits <<= 1;
+        }
+    }
+}
+void ttk_bitmap_gc(ttk_surface srf, ttk_gc gc, int x, int y, int w, int h,
+                   unsigned short* imagebits) {
+    ttk_bitmap(srf, x, y, w, h, imagebits, gc->fg);
+}
+
+static void draw_glyph(ttk_surface srf, int x, int y, ttk_color col, int ch) {
+    const unsigned char* g;
+    int i, j;
+
+    if (ch < 0x20 || ch > 0x7e) ch = '?';
+    g = glyphs + (ch - 0x20) * GLYPH_H;
+    if (x >= 0 && y >= 0 && x + GLYPH_W <= srf->w && y + GLYPH_H <= srf->h) {
+        for (j = 0; j < GLYPH_H; j++)
+            for (i = 0; i < GLYPH_W; i++)
+                if (g[j] & (0x80 >> i)) put(srf, x + i, y + j, col);
+    } else {
+        for (j = 0; j < GLYPH_H; j++)
+            for (i = 0; i < GLYPH_W; i++)
+                if (g[j] & (0x80 >> i)) ttk_pixel(srf, x + i, y + j, col);
+    }
+}
+
+// Each UTF-8 sequence counts as one character; anything past ASCII is '?'.
+static int utf8_next(const char** sp) {
+    const unsigned char* s = (const unsigned char*)*sp;
+    int ch = *s++;
+
+    if (ch >= 0x80) {
+        while ((*s & 0xc0) == 0x80) s++;
+        ch = '?';
+    }
+    *sp = (const char*)s;
+    return ch;
+}
+
+void ttk_text(ttk_surface srf, ttk_font fnt, int x, int y, ttk_color col,
+              const char* str) {
+    y += fnt->ofs;
+    while (*str) {
+        draw_glyph(srf, x, y, col, utf8_next(&str));
+        x += GLYPH_W;
+    }
+}
+void ttk_text_lat1(ttk_surface srf, ttk_font fnt, int x, int y, ttk_color col,
+                   const char* str) {
+    y += fnt->ofs;
+    for (; *str; str++, x += GLYPH_W)
+        draw_glyph(srf, x, y, col, (unsigned char)*str);
+}
+void ttk_text_uc16(ttk_surface srf, ttk_font fnt, int x, int y, ttk_color col,
+                   const uc16* str) {
+    y += fnt->ofs;
+    for (; *str; str++, x += GLYPH_W) draw_glyph(srf, x, y, col, *str);
+}
+int ttk_text_width(ttk_font fnt, const char* str) {
+    int n = 0;
+    if (!str) return 0;
+    while (*str) utf8_next(&str), n++;
+    return n * GLYPH_W;
+}
+int ttk_text_width_lat1(ttk_font fnt, const char* str) {
+    if (!str) return 0;
+    return strlen(str) * GLYPH_W;
+}
+int ttk_text_width_uc16(ttk_font fnt, const uc16* str) {
+    int n = 0;
+    if (!str) return 0;
+    while (*str++) n++;
+    return n * GLYPH_W;
+}
+int ttk_text_width_gc(ttk_gc gc, const char* str) {
+    return ttk_text_width(gc->font, str);
+}
+int ttk_text_height(ttk_font fnt) { return fnt->height; }
+int ttk_text_height_gc(ttk_gc gc) { return gc->font->height; }
+void ttk_textf(ttk_surface srf, ttk_font fnt, int x, int y, ttk_color col,
+               const char* fmt, ...) {
+    static char* buffer;
+    va_list ap;
+
+    if (!buffer) buffer = malloc(4096);
+
+    va_start(ap, fmt);
+    vsnprintf(buffer, 4096, fmt, ap);
+    va_end(ap);
+    ttk_text(srf, fnt, x, y, col, buffer);
+}
+void ttk_text_gc(ttk_surface srf, ttk_gc gc, int x, int y, const char* str) {
+    if (gc->usebg) {
+        ttk_fillrect(srf, x, y, x + ttk_text_width_gc(gc, str),
+                     y + ttk_text_height_gc(gc), gc->bg);
+    }
+    ttk_text(srf, gc->font, x, y - gc->font->ofs, gc->fg, str);
+}
+
+// Every font is the built-in one, so text metrics don't depend on what's
+// installed.
+void ttk_load_font(ttk_fontinfo* fi, const char* fnbase, int size) {
+    fi->f = calloc(1, sizeof(struct _ttk_font));
+    if (!fi->f) {
+        fi->good = 0;
+        return;
+    }
+    fi->f->height = GLYPH_H;
+}
+void ttk_unload_font(ttk_fontinfo* fi) {
+    free(fi->f);
+    fi->loaded = 0;
+    fi->good = 0;
+}
+
+static int pnm_int(FILE* fp) {
+    int c, v = 0;
+
+    while ((c = getc(fp)) != EOF && (c == '#' || c <= ' '))
+        if (c == '#')
+            while ((c = getc(fp)) != EOF && c != '\n');
+    if (c < '0' || c > '9') return -1;
+    do v = v * 10 + (c - '0');
+    while ((c = getc(fp)) >= '0' && c <= '9');
+    return v;
+}
+
+// Only binary PGM/PPM; there's no image library behind this backend.
+ttk_surface ttk_load_image(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    ttk_surface ret;
+    int type, w, h, max, x, y, r, g, b;
+
+    if (!fp) return 0;
+    if (getc(fp) != 'P' || ((type = getc(fp)) != '5' && type != '6') ||
+        (w = pnm_int(fp)) <= 0 || (h = pnm_int(fp)) <= 0 ||
+        (max = pnm_int(fp)) <= 0 || max > 255) {
+        fclose(fp);
+        return 0;
+    }
+
+    ret = alloc_surface(w, h, (ttk_screen->bpp == 16) ? 16 : 32);
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < w; x++) {
+            r = g = b = getc(fp);
+            if (type == '6') {
+                g = getc(fp);
+                b = getc(fp);
+            }
+            if (b == EOF) break;
+            put(ret, x, y,
+                ttk_makecol_ex(r * 255 / max, g * 255 / max, b * 255 / max,
+                               ret));
+        }
+    }
+    fclose(fp);
+    return ret;
+}
+
+void ttk_free_image(ttk_surface img) { ttk_free_surface(img); }
+void ttk_blit_image(ttk_surface src, ttk_surface dst, int dx, int dy) {
+    ttk_blit_image_ex(src, 0, 0, src->w, src->h, dst, dx, dy);
+}
+void ttk_blit_image_ex(ttk_surface src, int sx, int sy, int sw, int sh,
+                       ttk_surface dst, int dx, int dy) {
+    int x, y, r, g, b;
+    ttk_color c;
+
+    // clip to both surfaces
+    if (sx < 0) sw += sx, dx -= sx, sx = 0;
+    if (sy < 0) sh += sy, dy -= sy, sy = 0;
+    if (dx < 0) sw += dx, sx -= dx, dx = 0;
+    if (dy < 0) sh += dy, sy -= dy, dy = 0;
+    if (sx + sw > src->w) sw = src->w - sx;
+    if (sy + sh > src->h) sh = src->h - sy;
+    if (dx + sw > dst->w) sw = dst->w - dx;
+    if (dy + sh > dst->h) sh = dst->h - dy;
+    if (sw <= 0 || sh <= 0) return;
+
+    if (src->bpp == dst->bpp && !src->keyed) {
+        for (y = 0; y < sh; y++)
+            memmove(ROW(dst, dy + y) + dx * BYTESPP(dst),
+                    ROW(src, sy + y) + sx * BYTESPP(src), sw * BYTESPP(src));
+        return;
+    }
+
+    // keyed, same depth: copy the runs between transparent pixels, as
+    // SDL's colorkey blitters do
+    if (src->bpp == dst->bpp && src->bpp != 2) {
+        int bpp = BYTESPP(src);
+        unsigned int key = src->key;
+        for (y = 0; y < sh; y++) {
+            unsigned char* s = ROW(src, sy + y) + sx * bpp;
+            unsigned char* d = ROW(dst, dy + y) + dx * bpp;
+            x = 0;
+            while (x < sw) {
+                int run = x;
+                if (bpp == 2)
+                    while (run < sw && ((unsigned short*)s)[run] != key)
+                        run++;
+                else
+                    while (run < sw && ((unsigned int*)s)[run] != key) run++;
+                if (run > x) memcpy(d + x * bpp, s + x * bpp, (run - x) * bpp);
+                x = run + 1;
+            }
+        }
+        return;
+    }
+
+    for (y = 0; y < sh; y++) {
+        for (x = 0; x < sw; x++) {
+            c = ttk_getpixel(src, sx + x, sy + y);
+            if (src->keyed && c == src->key) continue;
+            if (src->bpp != dst->bpp) {
+                ttk_unmakecol_ex(c, &r, &g, &b, src);
+                c = ttk_makecol_ex(r, g, b, dst);
+            }
+            put(dst, dx + x, dy + y, c);
+        }
+    }
+}
+
+ttk_surface ttk_new_surface(int w, int h, int bpp) {
+    ttk_surface ret = alloc_surface(w, h, bpp);
+
+    if (ret->bpp != 2) {  // 2bpp surfaces start white, which is 0
+        ret->keyed = 1;
+        ret->key = ttk_makecol_ex(CKEY, ret);
+        ttk_fillrect(ret, 0, 0, w - 1, h - 1, ret->key);
+    }
+    return ret;
+}
+
+ttk_surface ttk_scale_surface(ttk_surface srf, float factor) {
+    int w = srf->w * factor, h = srf->h * factor, x, y;
+    ttk_surface ret = alloc_surface(w, h, srf->bpp);
+
+    ret->keyed = srf->keyed;
+    ret->key = srf->key;
+    for (y = 0; y < h; y++)
+        for (x = 0; x < w; x++)
+            put(ret, x, y, ttk_getpixel(srf, x / factor, y / factor));
+    return ret;
+}
+
+void ttk_surface_get_dimen(ttk_surface srf, int* w, int* h) {
+    if (w) *w = srf->w;
+    if (h) *h = srf->h;
+}
+
+void ttk_surface_set_opaque(ttk_surface srf) { srf->keyed = 0; }
+
+void ttk_free_surface(ttk_surface srf) {
+    if (!srf) return;
+    free(srf->pixels);
+    free(srf);
+}
+#endif
@@ -107,6 +107,29 @@ void ttk_gfx_quit() { SDL_Quit(); }
 
 void ttk_gfx_update(ttk_surface srf) { SDL_Flip(srf); }
 
+void ttk_gfx_update_rects(ttk_surface srf, int n, TRect* rects) {
+    SDL_Rect r[16];
+    int i;
+
+    // A page flip can't be done piecemeal.
+    if (srf->flags & SDL_DOUBLEBUF) {
+        SDL_Flip(srf);
+        return;
+    }
+
+    while (n > 0) {
+        for (i = 0; i < n && i < 16; i++) {
+            r[i].x = rects[i].x;
+            r[i].y = rects[i].y;
+            r[i].w = rects[i].w;
+            r[i].h = rects[i].h;
+        }
+        SDL_UpdateRects(srf, i, r);
+        rects += i;
+        n -= i;
+    }
+}
+
 int ttk_get_rawevent(int* arg) {
     SDL_Event ev;
     int tev = TTK_NO_EVENT;
@@ -210,25 +233,35 @@ void _internal_save_screenshot(void) {
 }
 #endif
 
-static int wait_event(SDL_Event* e, unsigned int ms) {
-    unsigned int time = SDL_GetTicks();
-    while (SDL_GetTicks() < time + ms) {
-        if (SDL_PollEvent(e)) return 1;
-        SDL_Delay(10);
+int ttk_gfx_wait_event(int ms) {
+    SDL_Event ev;
+    Uint32 until = SDL_GetTicks() + ms;
+    int left;
+
+    // SDL can't sleep on its event queue, so nap in short slices until
+    // something shows up or the deadline passes.
+    while (1) {
+        SDL_PumpEvents();
+        if (SDL_PeepEvents(&ev, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) > 0) return 1;
+        if (ms < 0) {
+            SDL_Delay(10);
+            continue;
+        }
+        left = (int)(until - SDL_GetTicks());
+        if (left <= 0) return 0;
+        SDL_Delay(MIN(left, 10));
     }
-    return 0;
 }
 
 int ttk_get_event(int* arg) {
-#define TIME 30
-    static SDL_Event ev;
-    int ms, tev = TTK_NO_EVENT;
-    unsigned int time = SDL_GetTicks() + TIME;
+    SDL_Event ev;
+    int tev = TTK_NO_EVENT;
 
     *arg = 0;
 
-    // We amalgamate adjacent scroll events to reduce lag.
-    while ((ms = SDL_GetTicks()) < time && wait_event(&ev, time - ms)) {
+    // Scroll events are passed on one at a time; ttk_run() merges them if
+    // it falls behind. Anything we don't care about is skipped.
+    while (SDL_PollEvent(&ev)) {
         switch (ev.type) {
             case SDL_QUIT:
                 ttk_quit();
@@ -279,12 +312,8 @@ int ttk_get_event(int* arg) {
                     case SDLK_l:
                     case SDLK_r:
                         if (ev.type == SDL_KEYUP) continue;
-                        tev = TTK_SCROLL;
-                        if (ev.key.keysym.sym == SDLK_r)
-                            (*arg)++;
-                        else
-                            (*arg)--;
-                        continue;
+                        *arg = (ev.key.keysym.sym == SDLK_r) ? 1 : -1;
+                        return TTK_SCROLL;
                     case SDLK_w:
                     case SDLK_LEFT:
                         *arg = TTK_BUTTON_PREVIOUS;
@@ -359,12 +388,11 @@ int ttk_get_event(int* arg) {
         }
     }
     return tev;
-#undef TIME
 }
 
-int ttk_getticks() { return SDL_GetTicks(); }
+int ttk_gfx_getticks() { return SDL_GetTicks(); }
 
-void ttk_delay(int ms) { SDL_Delay(ms); }
+void ttk_gfx_delay(int ms) { SDL_Delay(ms); }
 
 #ifndef MAX
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -2412,5 +2440,7 @@ void ttk_surface_get_dimen(ttk_surface srf, int* w, int* h) {
     if (h) *h = srf->h;
 }
 
+void ttk_surface_set_opaque(ttk_surface srf) { SDL_SetColorKey(srf, 0, 0); }
+
 void ttk_free_surface(ttk_surface srf) { SDL_FreeSurface(srf); }
 #endif
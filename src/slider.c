@@ -83,6 +83,7 @@ TWidget* ttk_new_special_slider_widget(int x, int y, int w, int h, int minval,
     ret->data = data;
     ret->focusable = 1;
     ret->draw = ttk_slider_draw;
+    ret->type = "slider";
     ret->down = ttk_slider_down;
     ret->scroll = ttk_slider_scroll;
     ret->destroy = ttk_slider_free;
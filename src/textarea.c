@@ -66,13 +66,10 @@ wrapit:
     p = data->text;
     xpos = 0;
 
-    // The text width functions should be very inexpensive, so we can just
-    // do them per-char and be simple.
+    // Measured a character at a time; ttk_text_advance() keeps each
+    // character's width, so this stays cheap.
 
     while (*p) {
-        char s[2] = {'?', 0};
-        s[0] = *p;
-
         if (lines > 10000) {
             fprintf(stderr, "Too many lines; showing only first 10,000.");
             *end++ = 0;
@@ -90,7 +87,9 @@ wrapit:
                 xpos = (xpos + 15) & 15;
                 break;
             default:
-                xpos += ttk_text_width(data->font, s);
+                // the rest of a UTF-8 character was counted with its first byte
+                if ((*p & 0xc0) != 0x80)
+                    xpos += ttk_text_advance(data->font, p);
                 break;
         }
 
@@ -226,6 +225,7 @@ TWidget* ttk_new_textarea_widget(int w, int h, const char* ctext, ttk_font font,
     ret->data = data;
     ret->focusable = 1;
     ret->draw = ttk_textarea_draw;
+    ret->type = "textarea";
     ret->down = ttk_textarea_down;
     ret->scroll = ttk_textarea_scroll;
     ret->destroy = ttk_textarea_free;
@@ -20,13 +20,16 @@
 
 #include "ttk.h"
 
+#ifndef NULLGFX
 #include <SDL.h>
+#endif
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 
 TWindowStack* ttk_windows = 0;
 ttk_font ttk_menufont, ttk_textfont;
@@ -43,7 +46,37 @@ int (*ttk_global_evhandler)(int, int, int);
 int (*ttk_global_unusedhandler)(int, int, int);
 int ttk_epoch = 0;
 
-static ttk_timer ttk_timers = 0;
+typedef struct ttk_heap {
+    ttk_heapent** v;
+    int n, alloc;
+} ttk_heap;
+
+#define TTK_REGION_RECTS 8
+typedef struct ttk_region {
+    TRect r[TTK_REGION_RECTS];
+    int n;
+} ttk_region;
+
+static ttk_region ttk_damaged;  // drawn to the screen, not yet presented
+static ttk_region ttk_drawn;    // widgets redrawn this pass, screen coords
+
+typedef struct ttk_timer_slot
+{
+    int started;
+    int delay;
+    void (*fn)();
+    struct ttk_timer_slot *next;  // free list
+    ttk_heapent ent;
+    unsigned int gen;  // bumped each time the slot is let go
+    unsigned int index;
+} ttk_timer_slot;
+
+static ttk_heap ttk_timers;
+static ttk_timer_slot* ttk_free_timers = 0;
+static void timer_release(ttk_timer_slot* t);
+static ttk_heap ttk_header_sched;
+static ttk_heap* running_sched = 0;
+static TWidget* running_wid = 0;
 static int ttk_transit_frames = 16;
 static void (*ttk_clicker)() = ttk_click;
 
@@ -174,6 +207,7 @@ static int ttk_parse_fonts_list(const char* flf) {
         current->refs = 0;
         current->loaded = 0;
         current->next = 0;
+        current->adv = 0;
         fonts++;
     }
 
@@ -247,6 +281,7 @@ ttk_fontinfo* ttk_get_fontinfo(const char* name, int size) {
     }
 
     if (!bestmatch->loaded) {
+        long long t0 = ttk_trace_begin();
         char tmp[256];
 
         strcpy(tmp, FONTSDIR);
@@ -258,6 +293,7 @@ ttk_fontinfo* ttk_get_fontinfo(const char* name, int size) {
         bestmatch->f->ofs = bestmatch->offset;
         bestmatch->f->fi = bestmatch;
         bestmatch->loaded = 1;
+        ttk_trace_end(t0, "load_font", "font", bestmatch->name);
         if (!bestmatch->good) return ttk_get_fontinfo("Any Font", 0);
     }
     bestmatch->refs++;
@@ -274,10 +310,126 @@ void ttk_done_fontinfo(ttk_fontinfo* fi) {
     if (fi->refs <= 0) {
         ttk_unload_font(fi);
         fi->loaded = 0;
+        free(fi->adv);
+        fi->adv = 0;
     }
 }
 void ttk_done_font(ttk_font f) { ttk_done_fontinfo(f->fi); }
 
+// Text fitting. Advances of ASCII characters are kept per font, so
+// fitting a string measures each character once rather than measuring
+// every shorter version of it.
+#define FIT_ELLIPSIS "..."
+
+static int utf8_length(const char* s) {
+    unsigned char c = *s;
+    int len = (c < 0xc0) ? 1 : (c < 0xe0) ? 2 : (c < 0xf0) ? 3 : 4, i;
+
+    for (i = 1; i < len; i++)
+        if ((s[i] & 0xc0) != 0x80) return i;  // cut short
+    return len;
+}
+
+int ttk_text_advance(ttk_font f, const char* s) {
+    char ch[5];
+    int len, i;
+
+    if (!*s) return 0;
+    if (!(*s & 0x80) && f->fi) {
+        if (!f->fi->adv) {
+            f->fi->adv = malloc(128 * sizeof(short));
+            for (i = 0; i < 128; i++) f->fi->adv[i] = -1;
+        }
+        if (f->fi->adv[(int)*s] < 0) {
+            ch[0] = *s, ch[1] = 0;
+            f->fi->adv[(int)*s] = ttk_text_width(f, ch);
+        }
+        return f->fi->adv[(int)*s];
+    }
+    len = utf8_length(s);
+    memcpy(ch, s, len);
+    ch[len] = 0;
+    return ttk_text_width(f, ch);
+}
+
+// Where the character ending just before s + end starts.
+static int utf8_back(const char* s, int end) {
+    while (end > 0 && (s[--end] & 0xc0) == 0x80)
+        ;
+    return end;
+}
+
+int ttk_text_fit(ttk_font f, const char* s, int width, int mode,
+                 ttk_fit* fit) {
+    int dot = ttk_text_advance(f, "."), ell = 3 * dot, space;
+    int w = 0, i = 0, a, cut = -1, cutw = 0, word = -1, wordw = 0, len;
+
+    // one pass, stopping once it's clear the whole string won't fit
+    while (s[i] && w <= width) {
+        a = ttk_text_advance(f, s + i);
+        if (cut < 0 && w + a + ell > width) cut = i, cutw = w;
+        if (cut < 0 && s[i] == ' ') word = i, wordw = w;
+        w += a;
+        i += utf8_length(s + i);
+    }
+    if (!s[i] && w <= width) {
+        fit->head = fit->tail = i;
+        fit->width = w;
+        return 0;
+    }
+    if (cut < 0) cut = i, cutw = w;  // only the last character didn't fit
+    len = i + strlen(s + i);
+
+    if (mode == TTK_FIT_MIDDLE) {
+        // half the room to each end, the start getting any odd pixel
+        int room = MAX(width - ell, 0), tw = 0, t = len, p;
+
+        for (i = 0, w = 0; s[i]; i += utf8_length(s + i)) {
+            a = ttk_text_advance(f, s + i);
+            if (w + a > (room + 1) / 2) break;
+            w += a;
+        }
+        while (t > i) {
+            p = utf8_back(s, t);
+            a = ttk_text_advance(f, s + p);
+            if (w + tw + a > room) break;
+            tw += a;
+            t = p;
+        }
+        fit->head = i;
+        fit->tail = t;
+        fit->width = w + ell + tw;
+        return 1;
+    }
+
+    if (mode == TTK_FIT_WORD && word > 0) cut = word, cutw = wordw;
+    // "word ..." looks like a missing word; drop the space
+    space = ttk_text_advance(f, " ");
+    while (cut > 0 && s[cut - 1] == ' ') cut--, cutw -= space;
+    fit->head = cut;
+    fit->tail = len;
+    fit->width = cutw + ell;
+    return 1;
+}
+
+void ttk_text_fitted(ttk_surface srf, ttk_font f, int x, int y, ttk_color col,
+                     const char* s, const ttk_fit* fit) {
+    char buf[256], *p = buf;
+    int tail = strlen(s + fit->tail),
+        len = fit->head + sizeof(FIT_ELLIPSIS) - 1 + tail;
+
+    if (!s[fit->head]) {
+        ttk_text(srf, f, x, y, col, s);
+        return;
+    }
+    if (len >= sizeof(buf)) p = malloc(len + 1);
+    memcpy(p, s, fit->head);
+    memcpy(p + fit->head, FIT_ELLIPSIS, sizeof(FIT_ELLIPSIS) - 1);
+    memcpy(p + len - tail, s + fit->tail, tail + 1);
+    ttk_text(srf, f, x, y, col, p);
+    if (p != buf) free(p);
+}
+
 TWindow* ttk_init() {
     TWindow* ret;
     ttk_color dots_b;
@@ -409,34 +561,663 @@ TWindow* ttk_init() {
     return ret;
 }
 
-void ttk_draw_window(TWindow* win) {
-    TApItem b, *bg;
+int ttk_button_pressed(int button) { return ttk_button_presstime[button]; }
+
+// Binary min-heap on ttk_heapent.due. Entries remember their slot, so they
+// can be removed or rescheduled in O(log n) without a search.
+static void heap_set(ttk_heap* h, int i, ttk_heapent* e) {
+    h->v[i] = e;
+    e->slot = i;
+}
+
+static void heap_up(ttk_heap* h, int i) {
+    ttk_heapent* e = h->v[i];
+    while (i > 0 && h->v[(i - 1) / 2]->due > e->due) {
+        heap_set(h, i, h->v[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    heap_set(h, i, e);
+}
+
+static void heap_down(ttk_heap* h, int i) {
+    ttk_heapent* e = h->v[i];
+    int child;
+    while ((child = 2 * i + 1) < h->n) {
+        if (child + 1 < h->n && h->v[child + 1]->due < h->v[child]->due)
+            child++;
+        if (h->v[child]->due >= e->due) break;
+        heap_set(h, i, h->v[child]);
+        i = child;
+    }
+    heap_set(h, i, e);
+}
+
+static void heap_push(ttk_heap* h, ttk_heapent* e) {
+    if (h->n == h->alloc) {
+        h->alloc = h->alloc ? h->alloc * 2 : 16;
+        h->v = realloc(h->v, h->alloc * sizeof(ttk_heapent*));
+    }
+    heap_set(h, h->n++, e);
+    heap_up(h, e->slot);
+}
+
+static void heap_remove(ttk_heap* h, ttk_heapent* e) {
+    int i = e->slot;
+    if (i < 0) return;
+
+    e->slot = -1;
+    if (i == --h->n) return;
+    heap_set(h, i, h->v[h->n]);
+    heap_up(h, i);
+    heap_down(h, h->v[i]->slot);
+}
+
+static int rects_touch(TRect* a, TRect* b) {
+    return a->x <= b->x + b->w && b->x <= a->x + a->w &&
+           a->y <= b->y + b->h && b->y <= a->y + a->h;
+}
+
+// Grows *a to cover *b as well.
+static void rect_union(TRect* a, TRect* b) {
+    int x2 = MAX(a->x + a->w, b->x + b->w);
+    int y2 = MAX(a->y + a->h, b->y + b->h);
+    a->x = MIN(a->x, b->x);
+    a->y = MIN(a->y, b->y);
+    a->w = x2 - a->x;
+    a->h = y2 - a->y;
+}
+
+// Adds a screen rectangle to [rg], folding it into any rectangles it
+// touches. Once the region is full, new rectangles are merged with
+// whichever existing one that grows the least.
+static void region_add(ttk_region* rg, int x, int y, int w, int h) {
+    TRect nr, tmp;
+    int i, best = 0, cost, bestcost = -1;
+
+    if (!ttk_screen) return;
+    if (x < 0) w += x, x = 0;
+    if (y < 0) h += y, y = 0;
+    if (x + w > ttk_screen->w) w = ttk_screen->w - x;
+    if (y + h > ttk_screen->h) h = ttk_screen->h - y;
+    if (w <= 0 || h <= 0) return;
+
+    nr.x = x;
+    nr.y = y;
+    nr.w = w;
+    nr.h = h;
+
+    for (i = 0; i < rg->n; i++) {
+        if (rects_touch(&rg->r[i], &nr)) {
+            rect_union(&nr, &rg->r[i]);
+            rg->r[i] = rg->r[--rg->n];
+            i = -1;  // it's bigger now; it may reach ones we passed
+        }
+    }
+
+    if (rg->n == TTK_REGION_RECTS) {
+        for (i = 0; i < rg->n; i++) {
+            tmp = rg->r[i];
+            rect_union(&tmp, &nr);
+            cost = tmp.w * tmp.h - rg->r[i].w * rg->r[i].h;
+            if (bestcost < 0 || cost < bestcost) {
+                best = i;
+                bestcost = cost;
+            }
+        }
+        rect_union(&nr, &rg->r[best]);
+        rg->r[best] = rg->r[--rg->n];
+    }
+
+    rg->r[rg->n++] = nr;
+}
+
+void ttk_damage(int x, int y, int w, int h) {
+    region_add(&ttk_damaged, x, y, w, h);
+}
+
+// The window chrome drawn around every frame, by interned handle.
+enum { AP_WINDOW_BG, AP_WINDOW_BORDER, AP_HEADER_LINE, AP_COUNT };
+
+static int ap_handle(int p) {
+    static const char* names[AP_COUNT] = {"window.bg", "window.border",
+                                           "header.line"};
+    static int handle[AP_COUNT];
+
+    if (!handle[p]) handle[p] = ttk_ap_intern(names[p]);
+    return handle[p];
+}
+
+static TApItem* chrome_ap(int p) { return ttk_ap_lookup(ap_handle(p)); }
+static TApItem* chrome_apx(int p) { return ttk_ap_lookupx(ap_handle(p)); }
+
+// Where the header line is drawn.
+static int header_line_y() {
+    TApItem* line = chrome_apx(AP_HEADER_LINE);
+    return ttk_screen->wy + ((line->type & TTK_AP_SPACING) ? line->spacing : 0);
+}
+
+// The window background, rendered once and kept until its appearance
+// item, size or the epoch changes.
+struct ttk_bgcache {
+    ttk_surface srf;
+    TApItem* ap;
+    int w, h, spacing, epoch, serial;
+};
+
+static int is_popup(TWindow* win) {
+    return win->x > ttk_screen->wx + 2 || win->y > ttk_screen->wy + 2;
+}
+
+static ttk_surface window_background(TWindow* win) {
+    struct ttk_bgcache* c = win->bgcache;
+    TApItem b, *ap;
+    int spacing = 0;
+
+    ap = win->background ? win->background : chrome_apx(AP_WINDOW_BG);
+    if (is_popup(win)) spacing = chrome_apx(AP_WINDOW_BORDER)->spacing;
+
+    if (!c) c = win->bgcache = calloc(1, sizeof(struct ttk_bgcache));
+    if (c->srf && c->ap == ap && c->w == win->w && c->h == win->h &&
+        c->spacing == spacing && c->epoch == ttk_epoch &&
+        c->serial == ttk_ap_serial)
+        return c->srf;
+
+    if (c->srf && (c->w != win->w || c->h != win->h)) {
+        ttk_free_surface(c->srf);
+        c->srf = 0;
+    }
+    if (!c->srf)
+        c->srf = ttk_new_surface(win->w, win->h, win->color ? 16 : 2);
+    ttk_fillrect(c->srf, 0, 0, win->w, win->h, ttk_makecol(CKEY));
+
+    memcpy(&b, ap, sizeof(TApItem));
+    b.spacing = spacing;
+    b.type |= TTK_AP_SPACING;
+    ttk_ap_fillrect(c->srf, &b, 0, 0, win->w, win->h);
+
+    c->ap = ap;
+    c->w = win->w;
+    c->h = win->h;
+    c->spacing = spacing;
+    c->epoch = ttk_epoch;
+    c->serial = ttk_ap_serial;
+    return c->srf;
+}
+
+// Paints the window-relative area (sx,sy,w,h) of [win] onto [dst] at
+// (dx,dy): background first, then whatever the widgets drew there.
+static void paint_window(TWindow* win, int sx, int sy, int w, int h,
+                         ttk_surface dst, int dx, int dy) {
+    ttk_blit_image_ex(window_background(win), sx, sy, w, h, dst, dx, dy);
+    ttk_blit_image_ex(win->srf, sx, sy, w, h, dst, dx, dy);
+}
+
+static void composite_window(TWindow* win, int x, int y, int w, int h) {
+    paint_window(win, x, y, w, h, ttk_screen->srf, win->x + x, win->y + y);
+}
+
+#define TRANSIT_FRAME_MS 16
+
+// The window slide in progress, if any. The window going away is copied
+// out when the slide starts, since it may be freed or reused meanwhile;
+// the other side is the live top window.
+static struct {
+    ttk_surface srf;
+    TWindow* live;
+    int hide;  // live window comes back from the left, old one leaves right
+    int w, h;
+    int start, duration, last;
+} transit;
+
+static void end_transit() {
+    if (!transit.srf) return;
+    ttk_free_surface(transit.srf);
+    transit.srf = 0;
+    transit.live = 0;
+    ttk_dirty |= TTK_DIRTY_WINDOWAREA;
+}
+
+static void start_transit(TWindow* out, TWindow* live, int hide) {
+    end_transit();
+    if (ttk_transit_frames <= 1) return;
+
+    transit.srf = ttk_new_surface(out->w, out->h, out->color ? 16 : 2);
+    ttk_fillrect(transit.srf, 0, 0, out->w, out->h,
+                 ttk_ap_getx("window.bg")->color);
+    paint_window(out, 0, 0, out->w, out->h, transit.srf, 0, 0);
+
+    transit.live = live;
+    transit.hide = hide;
+    transit.w = out->w;
+    transit.h = out->h;
+    transit.duration = ttk_transit_frames * TRANSIT_FRAME_MS;
+    transit.start = transit.last = ttk_getticks();
+    live->dirty++;
+}
+
+// Draws the slide as it should look at [tick]; frames we were too slow
+// for are simply never drawn. Returns 0 once it's over.
+static int draw_transit(TWindow* live, int tick) {
     ttk_screeninfo* s = ttk_screen;
+    int w = transit.w, h = transit.h, d;
+
+    if (transit.live != live || tick - transit.start >= transit.duration) {
+        end_transit();
+        return 0;
+    }
 
-    if (win->background) {
-        memcpy(&b, win->background, sizeof(TApItem));
+    // d is where the two windows meet.
+    d = w * (tick - transit.start) / transit.duration;
+    if (transit.hide) {
+        d = w - d;
+        paint_window(live, d, 0, w - d, h, s->srf, s->wx, s->wy);
+        ttk_blit_image_ex(transit.srf, 0, 0, d, h, s->srf, s->wx + w - d,
+                          s->wy);
     } else {
-        memcpy(&b, ttk_ap_getx("window.bg"), sizeof(TApItem));
+        ttk_blit_image_ex(transit.srf, d, 0, w - d, h, s->srf, s->wx, s->wy);
+        paint_window(live, 0, 0, d, h, s->srf, s->wx + w - d, s->wy);
     }
-    b.spacing = 0;
-    b.type |= TTK_AP_SPACING;
+    ttk_ap_hline(s->srf, chrome_ap(AP_HEADER_LINE), 0, s->w, s->wy);
 
-    if (win->x > s->wx + 2 || win->y > s->wy + 2)
-        b.spacing = ttk_ap_getx("window.border")->spacing;
-    bg = &b;
+    ttk_damage(s->wx, s->wy, w, h);
+    ttk_damage(0, header_line_y(), s->w, 1);
+    transit.last = tick;
+    return 1;
+}
+
+void ttk_draw_window(TWindow* win) {
+    ttk_screeninfo* s = ttk_screen;
 
-    ttk_ap_fillrect(s->srf, bg, win->x, win->y, win->x + win->w,
-                    win->y + win->h);
-    ttk_blit_image_ex(win->srf, 0, 0, win->w, win->h, s->srf, win->x, win->y);
+    composite_window(win, 0, 0, win->w, win->h);
     if (win->x > s->wx || win->y > s->wy) {  // popup window
-        ttk_ap_rect(s->srf, ttk_ap_get("window.border"), win->x, win->y,
+        ttk_ap_rect(s->srf, chrome_ap(AP_WINDOW_BORDER), win->x, win->y,
                     win->x + win->w, win->y + win->h);
     }
 
-    ttk_dirty |= TTK_DIRTY_WINDOWAREA | TTK_DIRTY_SCREEN;
+    ttk_dirty |= TTK_DIRTY_WINDOWAREA;
+    ttk_damage(win->x, win->y, win->w + 1, win->h + 1);
 }
 
-int ttk_button_pressed(int button) { return ttk_button_presstime[button]; }
+// Per-phase timings of the last TTK_STAT_FRAMES frames that did anything,
+// in microseconds (pixels for TTK_STAT_PIXELS). Off unless asked for.
+#define TTK_STAT_FRAMES 256
+static struct {
+    int on;
+    int asked, widgets;  // on if either: ttk_frame_stats_enable(), overlays
+    long long last;  // clock at the previous mark
+    int cur[TTK_NSTATS];
+    int v[TTK_NSTATS][TTK_STAT_FRAMES];
+    int n, pos;
+} fstats;
+
+// Microseconds since a second before this was first called; never 0.
+static long long usecs() {
+    static long base = 0;
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    if (!base) base = tv.tv_sec - 1;
+    return (tv.tv_sec - base) * 1000000LL + tv.tv_usec;
+}
+
+// Charges the time since the last mark to phase ph.
+static void stat_mark(int ph) {
+    long long now = usecs();
+    fstats.cur[ph] += now - fstats.last;
+    fstats.last = now;
+}
+#define STAT_MARK(ph)              \
+    do {                           \
+        if (fstats.on) stat_mark(ph); \
+    } while (0)
+
+static void stat_begin() {
+    memset(fstats.cur, 0, sizeof(fstats.cur));
+    fstats.last = usecs();
+}
+
+static void stat_end(int pixels, int busy) {
+    int i, total = 0;
+
+    if (!pixels && !busy) return;  // just woke up to find nothing to do
+    for (i = 0; i < TTK_STAT_FRAME; i++) total += fstats.cur[i];
+    fstats.cur[TTK_STAT_FRAME] = total;
+    fstats.cur[TTK_STAT_PIXELS] = pixels;
+    for (i = 0; i < TTK_NSTATS; i++) fstats.v[i][fstats.pos] = fstats.cur[i];
+    fstats.pos = (fstats.pos + 1) % TTK_STAT_FRAMES;
+    if (fstats.n < TTK_STAT_FRAMES) fstats.n++;
+}
+
+static void stats_switch(void) {
+    int on = fstats.asked || fstats.widgets;
+
+    if (on && !fstats.on) ttk_frame_stats_reset();
+    fstats.on = on;
+}
+
+void ttk_frame_stats_enable(int on) {
+    fstats.asked = on;
+    stats_switch();
+}
+
+void ttk_frame_stats_reset() { fstats.n = fstats.pos = 0; }
+
+static int cmp_int(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int ttk_frame_stats(int stat, ttk_frame_stat* st) {
+    int sorted[TTK_STAT_FRAMES];
+    long sum = 0;
+    int i;
+
+    memset(st, 0, sizeof(*st));
+    if (stat < 0 || stat >= TTK_NSTATS || !fstats.n) return 0;
+
+    memcpy(sorted, fstats.v[stat], fstats.n * sizeof(int));
+    qsort(sorted, fstats.n, sizeof(int), cmp_int);
+    for (i = 0; i < fstats.n; i++) sum += sorted[i];
+    st->min = sorted[0];
+    st->avg = sum / fstats.n;
+    st->p99 = sorted[(fstats.n * 99 - 1) / 100];
+    st->max = sorted[fstats.n - 1];
+    st->last = fstats.v[stat][(fstats.pos + TTK_STAT_FRAMES - 1) %
+                              TTK_STAT_FRAMES];
+    return fstats.n;
+}
+
+// The overlay: frame time and pixels presented, refreshed twice a second.
+static void frame_stats_draw(TWidget* this, ttk_surface srf) {
+    ttk_frame_stat fr, px;
+    char buf[64];
+    TApItem* fg = ttk_ap_getx("window.fg");
+
+    ttk_frame_stats(TTK_STAT_FRAME, &fr);
+    ttk_frame_stats(TTK_STAT_PIXELS, &px);
+    ttk_ap_fillrect(srf, ttk_ap_get("window.bg"), this->x, this->y,
+                    this->x + this->w, this->y + this->h);
+    sprintf(buf, "%d.%dms p99 %d.%d", fr.avg / 1000, fr.avg / 100 % 10,
+            fr.p99 / 1000, fr.p99 / 100 % 10);
+    ttk_text(srf, ttk_textfont, this->x + 1, this->y, fg->color, buf);
+    sprintf(buf, "%dpx", px.last);
+    ttk_text(srf, ttk_textfont, this->x + 1,
+             this->y + ttk_text_height(ttk_textfont), fg->color, buf);
+}
+
+static int frame_stats_timer(TWidget* this) {
+    this->dirty = 1;
+    return 0;
+}
+
+static void frame_stats_destroy(TWidget* this) {
+    fstats.widgets--;
+    stats_switch();
+}
+
+TWidget* ttk_new_frame_stats_widget(int x, int y) {
+    TWidget* ret = ttk_new_widget(x, y);
+
+    fstats.widgets++;
+    stats_switch();
+    ret->type = "framestats";
+    ret->w = ttk_text_width(ttk_textfont, "000.0ms p99 000.0") + 2;
+    ret->h = 2 * ttk_text_height(ttk_textfont);
+    ret->draw = frame_stats_draw;
+    ret->timer = frame_stats_timer;
+    ret->destroy = frame_stats_destroy;
+    ttk_widget_set_timer(ret, 500);
+    return ret;
+}
+
+// Spans for a Chrome trace_event file, in a ring allocated up front so
+// recording one is just a few stores. Names and types must be static.
+typedef struct ttk_trace_ev {
+    const char *name, *cat, *type;
+    char detail[32];
+    long long ts;
+    int dur;
+} ttk_trace_ev;
+
+static struct {
+    ttk_trace_ev* ev;  // 0 when not tracing
+    ttk_trace_ev* buf;
+    int size, n, pos;
+} trace;
+
+int ttk_trace_start(int events) {
+    if (events <= 0) events = 16384;
+    if (!trace.buf || trace.size != events) {
+        free(trace.buf);
+        trace.buf = malloc(events * sizeof(ttk_trace_ev));
+        if (!trace.buf) {
+            trace.ev = 0;
+            return -1;
+        }
+        trace.size = events;
+    }
+    trace.n = trace.pos = 0;
+    trace.ev = trace.buf;
+    return 0;
+}
+
+void ttk_trace_stop() { trace.ev = 0; }
+
+long long ttk_trace_begin() { return trace.ev ? usecs() : 0; }
+
+static ttk_trace_ev* trace_add(long long start, const char* name,
+                               const char* cat, const char* type) {
+    ttk_trace_ev* e = &trace.buf[trace.pos];
+
+    e->name = name;
+    e->cat = cat;
+    e->type = type;
+    e->detail[0] = 0;
+    e->ts = start;
+    e->dur = usecs() - start;
+    trace.pos = (trace.pos + 1) % trace.size;
+    if (trace.n < trace.size) trace.n++;
+    return e;
+}
+
+void ttk_trace_end(long long start, const char* name, const char* cat,
+                   const char* detail) {
+    ttk_trace_ev* e;
+
+    if (!start || !trace.ev) return;
+    e = trace_add(start, name, cat, 0);
+    if (detail) strncpy(e->detail, detail, sizeof(e->detail) - 1);
+    e->detail[sizeof(e->detail) - 1] = 0;
+}
+
+// A widget callback, tagged with the widget's type and window. Pass a
+// widget that might have been freed as 0.
+static void trace_widget(long long start, const char* name, TWidget* wid,
+                         const char* type) {
+    ttk_trace_ev* e;
+
+    if (!start || !trace.ev) return;
+    e = trace_add(start, name, "widget", type);
+    if (!wid)
+        return;
+    else if (!wid->win)
+        strcpy(e->detail, "(header)");
+    else if (wid->win->title)
+        strncpy(e->detail, wid->win->title, sizeof(e->detail) - 1);
+    e->detail[sizeof(e->detail) - 1] = 0;
+}
+
+static void json_string(FILE* f, const char* s) {
+    putc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            putc(*s, f);
+    }
+    putc('"', f);
+}
+
+int ttk_trace_dump(const char* file) {
+    FILE* f = fopen(file, "w");
+    int i;
+
+    if (!f) return -1;
+    fprintf(f, "{\"traceEvents\":[");
+    for (i = 0; i < trace.n; i++) {
+        ttk_trace_ev* e =
+            &trace.buf[(trace.pos - trace.n + i + trace.size) % trace.size];
+        const char* key = strcmp(e->cat, "widget") && strcmp(e->cat, "window")
+                              ? "detail"
+                              : "window";
+
+        fprintf(f, "%s\n{\"name\":", i ? "," : "");
+        json_string(f, e->name);
+        fprintf(f, ",\"cat\":");
+        json_string(f, e->cat);
+        fprintf(f, ",\"ph\":\"X\",\"ts\":%lld,\"dur\":%d,\"pid\":1,\"tid\":1",
+                e->ts, e->dur);
+        fprintf(f, ",\"args\":{");
+        if (e->type) {
+            fprintf(f, "\"type\":");
+            json_string(f, e->type);
+        }
+        if (e->detail[0]) {
+            fprintf(f, "%s\"%s\":", e->type ? "," : "", key);
+            json_string(f, e->detail);
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) ? -1 : 0;
+}
+
+// The header without its widgets: background, title and line.
+static struct {
+    ttk_surface srf;
+    char* title;
+    ttk_font font;
+    enum ttk_justification just;
+    int w, h, pos, epoch, serial, room;
+} header_base;
+
+// How wide the title at textpos can be without running under a header
+// widget.
+static int header_room(int textpos) {
+    TWidgetList* cur;
+    int lo = 0, hi = ttk_screen->w;
+
+    for (cur = ttk_header_widgets; cur; cur = cur->next) {
+        if (cur->v->x + cur->v->w <= textpos)
+            lo = MAX(lo, cur->v->x + cur->v->w);
+        else if (cur->v->x >= textpos)
+            hi = MIN(hi, cur->v->x);
+    }
+    switch (header_text_justification) {
+        case (TTK_TEXT_LEFT):
+            return hi - textpos - 2;
+        case (TTK_TEXT_RIGHT):
+            return textpos - lo - 2;
+        case (TTK_TEXT_CENTER):
+        default:
+            return 2 * MIN(textpos - lo, hi - textpos) - 4;
+    }
+}
+
+// Re-renders header_base if anything it's drawn from has changed;
+// returns 1 if it did.
+static int update_header_base(const char* title) {
+    ttk_screeninfo* s = ttk_screen;
+    const char* displayTitle;
+    int h = MAX(header_line_y(), s->wy) + 1;
+    int textpos = (header_text_pos >= 0) ? header_text_pos : (s->w >> 1);
+    int room = header_room(textpos);
+    ttk_fit fit;
+
+    if (header_base.srf && header_base.w == s->w && header_base.h == h &&
+        header_base.font == ttk_menufont &&
+        header_base.just == header_text_justification &&
+        header_base.pos == header_text_pos &&
+        header_base.epoch == ttk_epoch && header_base.serial == ttk_ap_serial &&
+        header_base.room == room && !strcmp(header_base.title, title))
+        return 0;
+
+    if (header_base.srf && (header_base.w != s->w || header_base.h != h)) {
+        ttk_free_surface(header_base.srf);
+        header_base.srf = 0;
+    }
+    if (!header_base.srf) header_base.srf = ttk_new_surface(s->w, h, s->bpp);
+    ttk_fillrect(header_base.srf, 0, 0, s->w, h, ttk_makecol(CKEY));
+
+    ttk_ap_fillrect(header_base.srf, ttk_ap_get("header.bg"), 0, 0, s->w,
+                    s->wy + ttk_ap_getx("header.line")->spacing);
+
+    /* autocenter if unset; shorten if it would run under a widget */
+    displayTitle = ttk_filter_sorting_characters(title);
+    ttk_text_fit(ttk_menufont, displayTitle, room, TTK_FIT_END, &fit);
+    switch (header_text_justification) {
+        case (TTK_TEXT_LEFT):
+            break;
+        case (TTK_TEXT_RIGHT):
+            textpos -= fit.width;
+            break;
+        case (TTK_TEXT_CENTER):
+        default:
+            textpos -= (fit.width >> 1);
+            break;
+    }
+    ttk_text_fitted(header_base.srf, ttk_menufont, textpos,
+                    (s->wy - ttk_text_height(ttk_menufont)) / 2,
+                    ttk_ap_getx("header.fg")->color, displayTitle, &fit);
+
+    ttk_ap_hline(header_base.srf, ttk_ap_get("header.line"), 0, s->w, s->wy);
+
+    free(header_base.title);
+    header_base.title = strdup(title);
+    header_base.font = ttk_menufont;
+    header_base.just = header_text_justification;
+    header_base.pos = header_text_pos;
+    header_base.epoch = ttk_epoch;
+    header_base.serial = ttk_ap_serial;
+    header_base.room = room;
+    header_base.w = s->w;
+    header_base.h = h;
+    return 1;
+}
+
+// Redraws a dirty header widget over its own patch of the header, leaving
+// the rest of it alone.
+static int draw_header_widget(TWidget* wid, int unused) {
+    long long t0;
+
+    if (!wid->dirty) return 0;
+
+    ttk_blit_image_ex(header_base.srf, wid->x, wid->y, wid->w, wid->h,
+                      ttk_screen->srf, wid->x, wid->y);
+    t0 = ttk_trace_begin();
+    wid->draw(wid, ttk_screen->srf);
+    trace_widget(t0, "draw", wid, wid->type);
+    wid->dirty = 0;
+    ttk_damage(wid->x, wid->y, wid->w, wid->h);
+    return 1;
+}
+
+// Returns whichever of two ticks comes first, treating -1 as "never".
+static int earlier(int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    return MIN(a, b);
+}
+
+// The tick at which [wid] next wants its frame or timer callback, or -1.
+static int widget_due(TWidget* wid) {
+    int due = -1;
+    if (wid->frame && wid->framedelay)
+        due = wid->framelast + wid->framedelay;
+    if (wid->timer && wid->timerdelay)
+        due = earlier(due, wid->timerlast + wid->timerdelay);
+    return due;
+}
 
 static int iterate_widgets(TWidgetList* wids, int (*func)(TWidget*, int),
                            int arg) {
@@ -449,40 +1230,487 @@ static int iterate_widgets(TWidgetList* wids, int (*func)(TWidget*, int),
     return eret;
 }
 
+// (Re)queues [wid] on its scheduler for whenever its frame or timer is
+// next due, or takes it off if it doesn't want either any more.
+static void sched_widget(TWidget* wid) {
+    ttk_heap* h = wid->schedheap;
+    int due = widget_due(wid);
+
+    if (!h) return;
+    if (due < 0) {
+        heap_remove(h, &wid->sched);
+    } else if (wid->sched.slot < 0) {
+        wid->sched.due = due;
+        heap_push(h, &wid->sched);
+    } else {
+        wid->sched.due = due;
+        heap_up(h, wid->sched.slot);
+        heap_down(h, wid->sched.slot);
+    }
+}
+
 static int do_timers(TWidget* wid, int tick) {
+    const char* type = wid->type;  // for tracing; wid may go away
+    long long t0;
     int eret = 0;
 
+    running_wid = wid;
+
     if (wid->frame && wid->framedelay &&
         (wid->framelast + wid->framedelay <= tick)) {
-        wid->framelast = tick;
+        // Step by whole periods, plus the millisecond 1000/fps drops every
+        // so often, so the rate doesn't drift. If we've fallen more than a
+        // frame behind, skip ahead rather than bunching frames up.
+        wid->framelast += wid->framedelay;
+        if (wid->framefps && (wid->frameacc += wid->framerem) >= wid->framefps) {
+            wid->frameacc -= wid->framefps;
+            wid->framelast++;
+        }
+        if (wid->framelast + wid->framedelay <= tick) wid->framelast = tick;
+        t0 = ttk_trace_begin();
         eret |= wid->frame(wid) & ~TTK_EV_UNUSED;
+        trace_widget(t0, "frame", running_wid == wid ? wid : 0, type);
+
+        // The frame handler may have freed the widget, or run a dialog.
+        if (running_wid != wid) return eret;
     }
 
     if (wid->timer && wid->timerdelay &&
         (wid->timerlast + wid->timerdelay <= tick)) {
-        wid->timerlast = tick + 1;
+        wid->timerlast += wid->timerdelay;
+        if (wid->timerlast + wid->timerdelay <= tick) wid->timerlast = tick;
+        t0 = ttk_trace_begin();
         eret |= wid->timer(wid) & ~TTK_EV_UNUSED;
+        trace_widget(t0, "timer", running_wid == wid ? wid : 0, type);
     }
 
     return eret;
 }
 
+// Runs the frame and timer handlers of the widgets on [h] that are due.
+static int run_sched(ttk_heap* h, int tick) {
+    TWidget* wid;
+    int eret = 0;
+
+    running_sched = h;
+    while (running_sched == h && h->n && h->v[0]->due <= tick) {
+        wid = h->v[0]->owner;
+        eret |= do_timers(wid, tick);
+        if (running_wid != wid) continue;  // freed, or a dialog ran
+
+        sched_widget(wid);
+    }
+    running_sched = 0;
+    running_wid = 0;
+    return eret;
+}
+
 static int do_draw(TWidget* wid, int force) {
     if (wid->dirty || force) {
-        if (!force)
+        if (!force) {
             ttk_fillrect(wid->win->srf, wid->x, wid->y, wid->x + wid->w,
                          wid->y + wid->h, ttk_makecol(CKEY));
+            region_add(&ttk_drawn, wid->win->x + wid->x, wid->win->y + wid->y,
+                       wid->w, wid->h);
+        }
+        long long t0 = ttk_trace_begin();
         if (wid->win)
             wid->draw(wid, wid->win->srf);
         else
             wid->draw(wid, ttk_screen->srf);
+        trace_widget(t0, "draw", wid, wid->type);
         wid->dirty = 0;
         return 1;
     }
     return 0;
 }
 
-static int check_dirty(TWidget* wid, int unused) { return !!wid->dirty; }
+// Input, in the order it arrived and stamped with when. ttk_run() drains
+// the backend into it and dispatches all of it every time around. There's
+// one producer and one consumer, and each only moves its own index, so no
+// locking is needed.
+#define TTK_EVQ_SIZE 256  // must be a power of two
+
+typedef struct ttk_qevent {
+    int ev, arg, time;
+} ttk_qevent;
+
+static struct {
+    ttk_qevent e[TTK_EVQ_SIZE];
+    volatile unsigned int head, tail;  // free-running; equal when empty
+    int overflows;
+} ttk_evq;
+
+// Scroll events that have waited longer than this (ms) get merged with
+// those queued behind them.
+static int ttk_scroll_budget = 20;
+
+static int evq_full() { return ttk_evq.tail - ttk_evq.head >= TTK_EVQ_SIZE; }
+
+static int evq_post(int ev, int arg, int time) {
+    ttk_qevent* e;
+
+    if (evq_full()) {
+        ttk_evq.overflows++;
+        return 0;
+    }
+    e = &ttk_evq.e[ttk_evq.tail & (TTK_EVQ_SIZE - 1)];
+    e->ev = ev;
+    e->arg = arg;
+    e->time = time;
+    ttk_evq.tail++;  // only once the entry is complete
+    return 1;
+}
+
+int ttk_event_overflows() { return ttk_evq.overflows; }
+
+void ttk_set_scroll_budget(int ms) { ttk_scroll_budget = MAX(ms, 0); }
+
+// Event logs, for recording input and replaying it later. A log is
+// REC_MAGIC followed by one entry per event: the event code as a byte,
+// the ms since the previous entry as a varint and the argument as a
+// zigzag varint. While replaying, the clock only moves when ttk_run()
+// would have slept, so timers and frames land on the same ticks on every
+// run no matter how long the drawing takes.
+#define REC_MAGIC "TTKev1"
+
+static FILE* rec_file;
+static int rec_last;
+
+static FILE* play_file;
+static void (*play_done)();
+static int play_clock, play_ev, play_arg, play_time;  // play_ev<0 => EOF
+
+static int clock_offset;  // keeps time going forwards after a replay
+
+int ttk_getticks() {
+    if (play_file) return play_clock;
+    return ttk_gfx_getticks() + clock_offset;
+}
+
+static void put_varint(FILE* f, unsigned int v) {
+    while (v >= 0x80) {
+        putc((v & 0x7f) | 0x80, f);
+        v >>= 7;
+    }
+    putc(v, f);
+}
+
+static int get_varint(FILE* f, unsigned int* v) {
+    int c, shift = 0;
+
+    *v = 0;
+    do {
+        if ((c = getc(f)) == EOF || shift > 28) return 0;
+        *v |= (c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return 1;
+}
+
+static void record_event(int ev, int arg, int time) {
+    putc(ev, rec_file);
+    put_varint(rec_file, time - rec_last);
+    put_varint(rec_file, ((unsigned int)arg << 1) ^ (arg >> 31));
+    rec_last = time;
+}
+
+int ttk_record_events(const char* file) {
+    if (rec_file) {
+        fclose(rec_file);
+        rec_file = 0;
+    }
+    if (!file) return 0;
+
+    if (!(rec_file = fopen(file, "wb"))) {
+        perror(file);
+        return -1;
+    }
+    fputs(REC_MAGIC, rec_file);
+    rec_last = ttk_getticks();
+    return 0;
+}
+
+// Reads the next entry into play_ev/arg/time.
+static void play_read() {
+    unsigned int dt, arg;
+    int ev = getc(play_file);
+
+    if (ev == EOF || !get_varint(play_file, &dt) ||
+        !get_varint(play_file, &arg)) {
+        play_ev = -1;
+        return;
+    }
+    play_ev = ev;
+    play_arg = (int)(arg >> 1) ^ -(int)(arg & 1);
+    play_time += dt;
+}
+
+static void end_replay() {
+    void (*done)() = play_done;
+
+    fclose(play_file);
+    play_file = 0;
+    play_done = 0;
+    clock_offset = play_clock - ttk_gfx_getticks();
+    if (done) (*done)();
+}
+
+int ttk_replay_events(const char* file, void (*done)()) {
+    char magic[sizeof(REC_MAGIC) - 1];
+    FILE* f = fopen(file, "rb");
+
+    if (!f) {
+        perror(file);
+        return -1;
+    }
+    if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+        memcmp(magic, REC_MAGIC, sizeof(magic))) {
+        fprintf(stderr, "%s: not an event log\n", file);
+        fclose(f);
+        return -1;
+    }
+
+    if (play_file) end_replay();
+    play_clock = play_time = ttk_getticks();
+    play_file = f;
+    play_done = done;
+    play_read();
+    return 0;
+}
+
+void ttk_delay(int ms) {
+    if (play_file)
+        play_clock += MAX(ms, 0);
+    else
+        ttk_gfx_delay(ms);
+}
+
+int ttk_wait_event(int ms) {
+    if (!play_file) return ttk_gfx_wait_event(ms);
+
+    // Skip straight to the deadline or the next logged event.
+    if (play_ev >= 0 && (ms < 0 || play_time <= play_clock + ms)) {
+        play_clock = MAX(play_clock, play_time);
+        return 1;
+    }
+    if (ms >= 0) play_clock += MAX(ms, 1);  // always move on a little
+    return 0;
+}
+
+// Moves everything the backend has into the queue. If the queue fills up
+// the rest is left where it is, to be picked up next time.
+static void drain_backend(TWidget* evtarget) {
+    int ev, arg, now;
+
+    while (!evq_full()) {
+        arg = 0;
+        if (evtarget && evtarget->rawkeys)
+            ev = ttk_get_rawevent(&arg);
+        else
+            ev = ttk_get_event(&arg);
+        if (ev == TTK_NO_EVENT) break;
+        if (play_file) continue;  // the log speaks for the user
+
+        now = ttk_getticks();
+        evq_post(ev, arg, now);
+        if (rec_file) record_event(ev, arg, now);
+    }
+
+    while (play_file && !evq_full()) {
+        if (play_ev < 0) {
+            end_replay();
+            break;
+        }
+        if (play_time > play_clock) break;
+        evq_post(play_ev, play_arg, play_time);
+        play_read();
+    }
+}
+
+// Sends one event, which happened at [time], where it needs to go. *held
+// is set to how long the button was down for a TTK_BUTTON_UP, else 0.
+static int dispatch_event(TWindow* win, TWidget* evtarget, int ev, int earg,
+                          int time, int* held) {
+    static int sofar = 0;
+    int local = 1, global = 1;
+    int eret = 0, dur, hs;
+    TWidget* pf;
+
+    *held = 0;
+
+    if (ev == TTK_TEXT) {
+        if (win->focus)  // NOT evtarget, that's probably the TI method
+            eret |= win->focus->input(win->focus, earg) & ~TTK_EV_UNUSED;
+        return eret;
+    }
+
+    if (!ttk_global_evhandler) global = 0;
+    if (ev == TTK_BUTTON_DOWN) {
+        if (!((ttk_button_pressedfor[earg] == 0 ||
+               ttk_button_pressedfor[earg] == evtarget) &&
+              (ttk_button_presstime[earg] == 0 ||
+               ttk_button_presstime[earg] == time)))  // key rept
+            global = 0;
+    }
+
+    if (!evtarget) local = 0;
+
+    if (global) {
+        local &= !ttk_global_evhandler(ev, earg,
+                                       time - ttk_button_presstime[earg]);
+    }
+
+    if (ev == TTK_SCROLL) {
+        if (ttk_scroll_denom > 1) {
+            sofar += earg;
+            if (sofar > -ttk_scroll_denom && sofar < ttk_scroll_denom)
+                local = 0;
+            else if (sofar < 0) {
+                while (sofar <= -ttk_scroll_denom) sofar += ttk_scroll_denom;
+            } else {
+                while (sofar >= ttk_scroll_denom) sofar -= ttk_scroll_denom;
+            }
+        }
+        earg *= ttk_scroll_num;
+    }
+
+    switch (ev) {
+        case TTK_BUTTON_DOWN:
+            if (!ttk_button_presstime[earg] ||
+                !ttk_button_pressedfor[earg]) {  // don't reset with
+                                                 // key-repted buttons
+                ttk_button_presstime[earg] = time;
+                ttk_button_pressedfor[earg] = evtarget;
+                ttk_button_holdsent[earg] = 0;
+            }
+
+            // Don't send different parts of same keyt-rept to different
+            // widgets:
+            if (local && (ttk_button_pressedfor[earg] == evtarget) &&
+                ((ttk_button_presstime[earg] == time) ||
+                 evtarget->keyrepeat)) {
+                int er = evtarget->down(evtarget, earg);
+                ttk_button_erets[earg] |= er;
+                eret |= er & ~TTK_EV_UNUSED;
+            }
+            break;
+        case TTK_BUTTON_UP:
+            dur = *held = time - ttk_button_presstime[earg];
+            pf = ttk_button_pressedfor[earg];
+            hs = ttk_button_holdsent[earg];
+
+            // Need to be before, in case button() launches its own
+            // ttk_run().
+            ttk_button_presstime[earg] = 0;
+            ttk_button_holdsent[earg] = 0;
+            ttk_button_pressedfor[earg] = 0;
+
+            if (evtarget == pf && local && !hs) {
+                int er = evtarget->button(evtarget, earg, dur);
+                // If *both* down and button returned unused, do unused.
+                // Otherwise, don't.
+                eret |= er;
+                if (!((er & TTK_EV_UNUSED) &&
+                      (ttk_button_erets[earg] & TTK_EV_UNUSED))) {
+                    eret &= ~TTK_EV_UNUSED;
+                } else {
+                    eret |= TTK_EV_UNUSED;
+                }
+            }
+
+            ttk_button_erets[earg] = 0;
+            break;
+        case TTK_SCROLL:
+            if (local)
+                eret |= evtarget->scroll(evtarget, earg) & ~TTK_EV_UNUSED;
+            break;
+    }
+
+#ifndef IPOD
+    // The keypad stands in for taps on the wheel.
+    if (evtarget && ev == TTK_BUTTON_UP) {
+        switch (earg) {
+            case '7':
+                eret |= evtarget->stap(evtarget, 84);
+                break;
+            case '8':
+                eret |= evtarget->stap(evtarget, 0);
+                break;
+            case '9':
+                eret |= evtarget->stap(evtarget, 12);
+                break;
+            case '6':
+                eret |= evtarget->stap(evtarget, 24);
+                break;
+            case '3':
+                eret |= evtarget->stap(evtarget, 36);
+                break;
+            case '2':
+                eret |= evtarget->stap(evtarget, 48);
+                break;
+            case '1':
+                eret |= evtarget->stap(evtarget, 60);
+                break;
+            case '4':
+                eret |= evtarget->stap(evtarget, 72);
+                break;
+            default:
+                break;
+        }
+    }
+#endif
+
+    return eret;
+}
+
+// How long ttk_run() can sleep waiting for input before it has something
+// else to do: 0 if work is pending already, -1 if only input can wake it.
+static int idle_timeout(TWindow* win, int tick) {
+    TWidget* evtarget;
+    const char* p;
+    int pending = ttk_dirty;
+    int due = -1;
+
+    if (!ttk_windows || ttk_windows->w != win || ttk_windows->minimized)
+        return 0;
+
+    // Header and input flags stay set while there's nothing to draw them on.
+    if (!win->show_header) pending &= ~TTK_DIRTY_HEADER;
+    if (!win->input) pending &= ~TTK_DIRTY_INPUT;
+    if (pending || win->dirty || win->epoch < ttk_epoch ||
+        ttk_evq.head != ttk_evq.tail)
+        return 0;
+
+    if (win->sched && win->sched->n)
+        due = earlier(due, win->sched->v[0]->due);
+    if (ttk_header_sched.n) due = earlier(due, ttk_header_sched.v[0]->due);
+    if (win->input) {
+        if (win->input->dirty) return 0;
+        due = earlier(due, widget_due(win->input));
+    }
+    if (ttk_timers.n) due = earlier(due, ttk_timers.v[0]->due + 1);
+    if (transit.srf) due = earlier(due, transit.last + TRANSIT_FRAME_MS);
+
+    // Wake up in time to deliver held-button events.
+    evtarget = win->input ? win->input : win->focus;
+    if (evtarget && evtarget->held != ttk_widget_noaction_1) {
+        for (p = "mfwd\n"; *p; p++) {
+            if (ttk_button_presstime[*p] && !ttk_button_holdsent[*p])
+                due = earlier(due, ttk_button_presstime[*p] +
+                                       evtarget->holdtime);
+        }
+    }
+
+#ifdef IPOD
+    // Taps on the newer wheels are found by polling the controller.
+    if (ttk_get_podversion() & TTK_POD_PP502X)
+        due = earlier(due, tick + 50);
+#endif
+
+    if (due < 0) return -1;
+    return MAX(due - tick, 0);
+}
 
 int ttk_run() {
     ttk_screeninfo* s = ttk_screen;
@@ -495,12 +1723,10 @@ int ttk_run() {
     int iter = 0;
     const char *keys = "mfwd\n", *p;
     static int initd = 0;
-    int local, global;
-    static int sofar = 0;
-    int time = 0, hs;
-    ttk_timer ctim;
-    int textpos = 0;
-    TWidget* pf;
+    int idle, winfull;
+    int pixels, nev;  // for the frame stats
+    long long tframe, t0;  // for the trace
+    ttk_timer_slot* ctim;
 
     ttk_started = 1;
 
@@ -538,6 +1764,8 @@ int ttk_run() {
             evtarget = win->focus;
 
         tick = ttk_getticks();
+        if (fstats.on) stat_begin();
+        tframe = ttk_trace_begin();
 
         if (win->epoch < ttk_epoch) {
             ttk_dirty |= TTK_FILTHY;
@@ -548,138 +1776,80 @@ int ttk_run() {
         /********** EVENT STUFF **********/
 
         eret = 0;
+        idle = 1;
+        pixels = nev = 0;
 
-        /*** Do header widget timers, and check for need to redraw the header
-         * ***/
-        if (ttk_header_widgets) {
-            eret |= iterate_widgets(ttk_header_widgets, do_timers, tick) &
-                    ~TTK_EV_UNUSED;
-            if (win->show_header &&
-                iterate_widgets(ttk_header_widgets, check_dirty, 0)) {
-                ttk_dirty |= TTK_DIRTY_HEADER;
-            }
-        }
+        /*** Do header widget timers. ***/
+        if (ttk_header_sched.n)
+            eret |= run_sched(&ttk_header_sched, tick) & ~TTK_EV_UNUSED;
 
         /*** Do timers for TI, and check if it wants a draw. ***/
         if (win->input) {
             eret |= do_timers(win->input, tick) & ~TTK_EV_UNUSED;
-            if (win->input->dirty) {
+            running_wid = 0;
+            if (win->input && win->input->dirty) {
                 ttk_dirty |= TTK_DIRTY_INPUT;
             }
         }
 
         /*** Do timers for widgets. ***/
-        eret |= iterate_widgets(win->widgets, do_timers, tick) & ~TTK_EV_UNUSED;
+        if (win->sched)
+            eret |= run_sched(win->sched, tick) & ~TTK_EV_UNUSED;
 
         /*** Do global timers. ***/
-        ctim = ttk_timers;
-        while (ctim) {
-            if (tick > (ctim->started + ctim->delay)) {
-                ttk_timer next = ctim->next;
-                void (*fn)() = ctim->fn;
-                ttk_destroy_timer(ctim);
-                ctim = next;
-                // We delay the call of fn in case it itself
-                // calls ttk_run() (e.g. for a dialog).
-                fn();
-                continue;
-            }
-            ctim = ctim->next;
+        while (ttk_timers.n && tick > ttk_timers.v[0]->due) {
+            ctim = ttk_timers.v[0]->owner;
+            void (*fn)() = ctim->fn;
+            timer_release(ctim);
+            // We delay the call of fn in case it itself
+            // calls ttk_run() (e.g. for a dialog).
+            fn();
         }
+        STAT_MARK(TTK_STAT_TIMERS);
 
         /*** Check for events. ***/
-        if (evtarget && evtarget->rawkeys)
-            ev = ttk_get_rawevent(&earg);
-        else
-            ev = ttk_get_event(&earg);
-
-        local = global = 1;
-
-        if (!ev) local = global = 0;
-
-        if (!ttk_global_evhandler) global = 0;
-        if (ev == TTK_BUTTON_DOWN) {
-            if (!((ttk_button_pressedfor[earg] == 0 ||
-                   ttk_button_pressedfor[earg] == evtarget) &&
-                  (ttk_button_presstime[earg] == 0 ||
-                   ttk_button_presstime[earg] == tick)))  // key rept
-                global = 0;
-        }
-
-        if (!evtarget) local = 0;
-
-        if (global) {
-            local &= !ttk_global_evhandler(ev, earg,
-                                           tick - ttk_button_presstime[earg]);
-        }
-
-        if (ev == TTK_SCROLL) {
-            if (ttk_scroll_denom > 1) {
-                sofar += earg;
-                if (sofar > -ttk_scroll_denom && sofar < ttk_scroll_denom)
-                    local = 0;
-                else if (sofar < 0) {
-                    while (sofar <= -ttk_scroll_denom)
-                        sofar += ttk_scroll_denom;
-                } else {
-                    while (sofar >= ttk_scroll_denom) sofar -= ttk_scroll_denom;
+        drain_backend(evtarget);
+        while (ttk_evq.head != ttk_evq.tail) {
+            ttk_qevent* qe = &ttk_evq.e[ttk_evq.head & (TTK_EVQ_SIZE - 1)];
+            int er, held, etime = qe->time;
+            ev = qe->ev;
+            earg = qe->arg;
+            ttk_evq.head++;
+
+            // Scroll ticks that sat in the queue longer than the budget
+            // mean we're falling behind; hand over everything waiting at
+            // once rather than redraw for each one.
+            if (ev == TTK_SCROLL &&
+                ttk_getticks() - etime > ttk_scroll_budget) {
+                while (ttk_evq.head != ttk_evq.tail) {
+                    qe = &ttk_evq.e[ttk_evq.head & (TTK_EVQ_SIZE - 1)];
+                    if (qe->ev != TTK_SCROLL) break;
+                    earg += qe->arg;
+                    ttk_evq.head++;
                 }
             }
-            earg *= ttk_scroll_num;
-        }
 
-        /*** Send events. ***/
-        switch (ev) {
-            case TTK_BUTTON_DOWN:
-                if (!ttk_button_presstime[earg] ||
-                    !ttk_button_pressedfor[earg]) {  // don't reset with
-                                                     // key-repted buttons
-                    ttk_button_presstime[earg] = tick;
-                    ttk_button_pressedfor[earg] = evtarget;
-                    ttk_button_holdsent[earg] = 0;
-                }
+            // Don't make the user wait on an animation to see what they did.
+            if (transit.srf) end_transit();
 
-                // Don't send different parts of same keyt-rept to different
-                // widgets:
-                if (local && (ttk_button_pressedfor[earg] == evtarget) &&
-                    ((ttk_button_presstime[earg] == tick) ||
-                     evtarget->keyrepeat)) {
-                    int er = evtarget->down(evtarget, earg);
-                    ttk_button_erets[earg] |= er;
-                    eret |= er & ~TTK_EV_UNUSED;
-                }
-                break;
-            case TTK_BUTTON_UP:
-                time = tick - ttk_button_presstime[earg];
-                pf = ttk_button_pressedfor[earg];
-                hs = ttk_button_holdsent[earg];
-
-                // Need to be before, in case button() launches its own
-                // ttk_run().
-                ttk_button_presstime[earg] = 0;
-                ttk_button_holdsent[earg] = 0;
-                ttk_button_pressedfor[earg] = 0;
-
-                if (evtarget == pf && local && !hs) {
-                    int er = evtarget->button(evtarget, earg, time);
-                    // If *both* down and button returned unused, do unused.
-                    // Otherwise, don't.
-                    eret |= er;
-                    if (!((er & TTK_EV_UNUSED) &&
-                          (ttk_button_erets[earg] & TTK_EV_UNUSED))) {
-                        eret &= ~TTK_EV_UNUSED;
-                    } else {
-                        eret |= TTK_EV_UNUSED;
-                    }
-                }
+            // An earlier event may have opened or closed a window.
+            win = ttk_windows->w;
+            evtarget = win->input ? win->input : win->focus;
 
-                ttk_button_erets[earg] = 0;
-                break;
-            case TTK_SCROLL:
-                if (local)
-                    eret |= evtarget->scroll(evtarget, earg) & ~TTK_EV_UNUSED;
-                break;
+            er = dispatch_event(win, evtarget, ev, earg, etime, &held);
+            nev++;
+            if ((er & TTK_EV_UNUSED) && ttk_global_unusedhandler) {
+                ttk_global_unusedhandler(ev, earg, held);
+                idle = 0;  // it may have dirtied things behind our back
+            }
+            eret |= er & ~TTK_EV_UNUSED;
+
+            if (!ttk_windows || (eret & TTK_EV_DONE)) break;
         }
+        if (!ttk_windows) return 0;
+
+        win = ttk_windows->w;
+        evtarget = win->input ? win->input : win->focus;
 
         /*** Check more events. ***/
         if (evtarget) {
@@ -729,49 +1899,9 @@ int ttk_run() {
                     ttk_ignore_stap = 0;
                 }
             }
-#else
-            if (ev == TTK_BUTTON_UP) {
-                switch (earg) {
-                    case '7':
-                        eret |= evtarget->stap(evtarget, 84);
-                        break;
-                    case '8':
-                        eret |= evtarget->stap(evtarget, 0);
-                        break;
-                    case '9':
-                        eret |= evtarget->stap(evtarget, 12);
-                        break;
-                    case '6':
-                        eret |= evtarget->stap(evtarget, 24);
-                        break;
-                    case '3':
-                        eret |= evtarget->stap(evtarget, 36);
-                        break;
-                    case '2':
-                        eret |= evtarget->stap(evtarget, 48);
-                        break;
-                    case '1':
-                        eret |= evtarget->stap(evtarget, 60);
-                        break;
-                    case '4':
-                        eret |= evtarget->stap(evtarget, 72);
-                        break;
-                    default:
-                        break;
-                }
-            }
 #endif
         }
-
-        /*** Process text input events. ***/
-        while (win->inbuf_start != win->inbuf_end) {
-            if (win->focus)  // NOT evtarget, that's probably the TI method
-                eret |= win->focus->input(win->focus,
-                                          win->inbuf[win->inbuf_start]) &
-                        ~TTK_EV_UNUSED;
-            win->inbuf_start++;
-            win->inbuf_start &= 0x1f;
-        }
+        STAT_MARK(TTK_STAT_EVENTS);
 
         /********** DRAWING STUFF **********/
 
@@ -781,45 +1911,20 @@ int ttk_run() {
 
         /*** Draw header, if necessary ***/
 
-        if ((ttk_dirty & TTK_DIRTY_HEADER) && win->show_header) {
-            const char* displayTitle =
-                ttk_filter_sorting_characters(win->title);
-            /* Clear it */
-            ttk_ap_fillrect(s->srf, ttk_ap_get("header.bg"), 0, 0, s->w,
-                            s->wy + ttk_ap_getx("header.line")->spacing);
-
-            /* Draw the widgets */
-            if (ttk_header_widgets)
-                iterate_widgets(ttk_header_widgets, do_draw, 1);
-
-            /* Draw title */
-            /* autocenter if unset */
-            textpos =
-                ((header_text_pos >= 0) ? header_text_pos : ((s->w) >> 1));
-
-            switch (header_text_justification) {
-                case (TTK_TEXT_LEFT):
-                    break;
-                case (TTK_TEXT_RIGHT):
-                    textpos -= ttk_text_width(ttk_menufont, displayTitle);
-                    break;
-                case (TTK_TEXT_CENTER):
-                default:
-                    textpos -=
-                        (ttk_text_width(ttk_menufont, displayTitle) >> 1);
-                    break;
+        if (win->show_header) {
+            if (update_header_base(win->title) ||
+                (ttk_dirty & TTK_DIRTY_HEADER)) {
+                ttk_blit_image(header_base.srf, s->srf, 0, 0);
+                if (ttk_header_widgets)
+                    iterate_widgets(ttk_header_widgets, do_draw, 1);
+
+                ttk_dirty &= ~TTK_DIRTY_HEADER;
+                ttk_damage(0, 0, s->w, header_base.h);
+            } else if (ttk_header_widgets) {
+                iterate_widgets(ttk_header_widgets, draw_header_widget, 0);
             }
-
-            ttk_text(s->srf, ttk_menufont, textpos,
-                     (s->wy - ttk_text_height(ttk_menufont)) / 2,
-                     ttk_ap_getx("header.fg")->color, displayTitle);
-
-            /* Draw line */
-            ttk_ap_hline(s->srf, ttk_ap_get("header.line"), 0, s->w, s->wy);
-
-            ttk_dirty &= ~TTK_DIRTY_HEADER;
-            ttk_dirty |= TTK_DIRTY_SCREEN;
         }
+        STAT_MARK(TTK_STAT_HEADER);
 
         /*** Redraw the widgets in the window, if it's dirty. ***/
         if (win->dirty) {
@@ -832,50 +1937,75 @@ int ttk_run() {
         }
 
         /*** Draw widgets that need it. ***/
+        winfull = ttk_dirty & TTK_DIRTY_WINDOWAREA;
+        ttk_drawn.n = 0;
         if (iterate_widgets(win->widgets, do_draw, 0)) {
             ttk_dirty |= TTK_DIRTY_WINDOWAREA;
         }
 
         /*** Draw the window surface to the screen surface. ***/
+        if (transit.srf) {
+            if (draw_transit(win, tick))
+                ttk_dirty &= ~TTK_DIRTY_WINDOWAREA;
+            else
+                winfull = 1;
+        }
         if (ttk_dirty & TTK_DIRTY_WINDOWAREA) {
-            TApItem b, *bg;
-            if (win->background) {
-                memcpy(&b, win->background, sizeof(TApItem));
+            if (winfull) {
+                composite_window(win, 0, 0, win->w, win->h);
+                if (is_popup(win)) {
+                    ttk_ap_rect(s->srf, chrome_ap(AP_WINDOW_BORDER), win->x,
+                                win->y, win->x + win->w, win->y + win->h);
+                }
+                if (win->show_header)
+                    ttk_ap_hline(s->srf, chrome_ap(AP_HEADER_LINE), 0, s->w,
+                                 s->wy);
+
+                ttk_damage(win->x, win->y, win->w + 1, win->h + 1);
+                if (win->show_header) ttk_damage(0, header_line_y(), s->w, 1);
+                if (win->input) ttk_dirty |= TTK_DIRTY_INPUT;
             } else {
-                memcpy(&b, ttk_ap_getx("window.bg"), sizeof(TApItem));
-            }
-            b.spacing = 0;
-            b.type |= TTK_AP_SPACING;
-
-            if (win->x > s->wx + 2 || win->y > s->wy + 2)
-                b.spacing = ttk_ap_getx("window.border")->spacing;
-            bg = &b;
-
-            ttk_ap_fillrect(s->srf, bg, win->x, win->y, win->x + win->w,
-                            win->y + win->h);
-            ttk_blit_image_ex(win->srf, 0, 0, win->w, win->h, s->srf, win->x,
-                              win->y);
-            if (win->x > s->wx + 2 || win->y > s->wy + 2) {  // popup window
-                ttk_ap_rect(s->srf, ttk_ap_get("window.border"), win->x, win->y,
-                            win->x + win->w, win->y + win->h);
+                // Only the widgets that drew this time around.
+                for (i = 0; i < ttk_drawn.n; i++) {
+                    TRect* r = &ttk_drawn.r[i];
+                    composite_window(win, r->x - win->x, r->y - win->y, r->w,
+                                     r->h);
+                    ttk_damage(r->x, r->y, r->w, r->h);
+
+                    if (is_popup(win) &&
+                        (r->x <= win->x || r->y <= win->y ||
+                         r->x + r->w >= win->x + win->w ||
+                         r->y + r->h >= win->y + win->h)) {
+                        ttk_ap_rect(s->srf, chrome_ap(AP_WINDOW_BORDER),
+                                    win->x, win->y, win->x + win->w,
+                                    win->y + win->h);
+                    }
+                    if (win->show_header && r->y <= header_line_y() &&
+                        r->y + r->h > header_line_y()) {
+                        ttk_ap_hline(s->srf, chrome_ap(AP_HEADER_LINE), 0,
+                                     s->w, s->wy);
+                    }
+                    if (win->input) {
+                        TRect in = {win->input->x, win->input->y,
+                                    win->input->w, win->input->h};
+                        if (rects_touch(r, &in)) ttk_dirty |= TTK_DIRTY_INPUT;
+                    }
+                }
             }
 
-            if (win->show_header)
-                ttk_ap_hline(s->srf, ttk_ap_get("header.line"), 0, s->w, s->wy);
-
             ttk_dirty &= ~TTK_DIRTY_WINDOWAREA;
-            ttk_dirty |= TTK_DIRTY_SCREEN;
         }
+        STAT_MARK(TTK_STAT_DRAW);
 
         /*** Redraw input if necessary. ***/
         if ((ttk_dirty & TTK_DIRTY_INPUT) && win->input) {
-            ttk_ap_fillrect(s->srf, ttk_ap_get("window.bg"), win->input->x,
+            ttk_ap_fillrect(s->srf, chrome_ap(AP_WINDOW_BG), win->input->x,
                             win->input->y, win->input->x + win->input->w,
                             win->input->y + win->input->h);
 
-            if (ttk_ap_get("window.border")) {
+            if (chrome_ap(AP_WINDOW_BORDER)) {
                 TApItem border;
-                memcpy(&border, ttk_ap_getx("window.border"), sizeof(TApItem));
+                memcpy(&border, chrome_ap(AP_WINDOW_BORDER), sizeof(TApItem));
                 border.spacing = -1;
 
                 ttk_ap_rect(s->srf, &border, win->input->x, win->input->y,
@@ -883,28 +2013,45 @@ int ttk_run() {
                             win->input->y + win->input->h);
             }
 
+            t0 = ttk_trace_begin();
             win->input->draw(win->input, s->srf);
+            trace_widget(t0, "draw", win->input, win->input->type);
 
             ttk_dirty &= ~TTK_DIRTY_INPUT;
-            ttk_dirty |= TTK_DIRTY_SCREEN;
+            ttk_damage(win->input->x, win->input->y, win->input->w + 1,
+                       win->input->h + 1);
         }
+        STAT_MARK(TTK_STAT_INPUT);
 
         /********** FINISHING UP **********/
 
         /*** Handle appropriate event actions. ***/
         if (eret & TTK_EV_CLICK) (*ttk_clicker)();
         if (eret & TTK_EV_DONE) return (eret >> 8);
-        if ((eret & TTK_EV_UNUSED) && ttk_global_unusedhandler)
-            eret |= ttk_global_unusedhandler(ev, earg, time);
 
         /*** Update the screen if we need it. ***/
+        t0 = ttk_trace_begin();
         if (ttk_dirty & TTK_DIRTY_SCREEN) {
             ttk_gfx_update(ttk_screen->srf);
             ttk_dirty &= ~TTK_DIRTY_SCREEN;
+            pixels = s->w * s->h;
+        } else if (ttk_damaged.n) {
+            ttk_gfx_update_rects(ttk_screen->srf, ttk_damaged.n,
+                                 ttk_damaged.r);
+            for (i = 0; i < ttk_damaged.n; i++)
+                pixels += ttk_damaged.r[i].w * ttk_damaged.r[i].h;
         }
-#if !defined(IPOD) && !defined(SDL)
-        ttk_delay(30);
-#endif
+        if (pixels) ttk_trace_end(t0, "gfx_update", "gfx", 0);
+        ttk_damaged.n = 0;
+        ttk_trace_end(tframe, "ttk_run", "run", 0);
+        if (fstats.on) {
+            stat_mark(TTK_STAT_UPDATE);
+            stat_end(pixels, eret || !idle || nev);
+        }
+
+        /*** Sleep until the next deadline, or until input arrives. ***/
+        if (ttk_windows && idle)
+            ttk_wait_event(idle_timeout(ttk_windows->w, ttk_getticks()));
     }
 }
 
@@ -943,6 +2090,7 @@ void ttk_click_ex(int period, int duration) {
 void ttk_click() { ttk_click_ex(20, 2); }
 
 void ttk_quit() {
+    ttk_record_events(0);
     ttk_gfx_quit();
     ttk_stop_cop();
 }
@@ -1011,7 +2159,7 @@ void ttk_get_screensize(int* w, int* h, int* bpp) {
     if (bpp) *bpp = ttk_screen->bpp;
 }
 
-#ifndef IPOD
+#if !defined(IPOD) && !defined(NULLGFX)
 typedef struct sdl_additional {
     Uint32 video_flags;
     Uint32 video_flags_mask;
@@ -1032,10 +2180,12 @@ void ttk_set_emulation(int w, int h, int bpp) {
     ttk_screen->h = ABS(h);
     ttk_screen->bpp = ABS(bpp);
 
+#ifndef NULLGFX
     if (bpp < 0 || w < 0 || h < 0) {
         sdl_add.video_flags = SDL_FULLSCREEN;
         sdl_add.video_flags_mask = SDL_FULLSCREEN;
     }
+#endif
 
     ttk_screen->wx = 0;
     if (ttk_screen->bpp == 16) {
@@ -1064,7 +2214,6 @@ TWindow* ttk_new_window() {
     ret->focus = ret->input = 0;
     ret->dirty = 0;
     ret->epoch = ttk_epoch;
-    ret->inbuf_start = ret->inbuf_end = 0;
     ret->onscreen = 0;
 
     if (ttk_windows) {
@@ -1117,17 +2266,29 @@ void ttk_free_window(TWindow* win) {
         while (cur) {
             next = cur->next;
             cur->v->win = 0;
+            cur->v->schedheap = 0;
             ttk_free_widget(cur->v);
             free(cur);
             cur = next;
         }
     }
+    if (win->sched) {
+        if (running_sched == win->sched) running_sched = 0;
+        free(win->sched->v);
+        free(win->sched);
+    }
+    if (win->bgcache) {
+        if (win->bgcache->srf) ttk_free_surface(win->bgcache->srf);
+        free(win->bgcache);
+    }
     ttk_free_surface(win->srf);
     if (win->titlefree) free((void*)win->title);
     free(win);
 }
 
 void ttk_show_window(TWindow* win) {
+    long long t0 = ttk_trace_begin();
+
     if (!win->onscreen) {
         TWindow* oldwindow = ttk_windows ? ttk_windows->w : 0;
         TWindowStack* next = ttk_windows;
@@ -1141,39 +2302,7 @@ void ttk_show_window(TWindow* win) {
         if (ttk_started && oldwindow && oldwindow->w == win->w &&
             oldwindow->h == win->h && oldwindow->x == ttk_screen->wx &&
             oldwindow->y == ttk_screen->wy) {
-            int i;
-            int jump = win->w / ttk_transit_frames;
-
-            // Render the stuff in the new window
-            ttk_fillrect(win->srf, 0, 0, win->w, win->h, ttk_makecol(CKEY));
-            iterate_widgets(win->widgets, do_draw, 1);
-
-            for (i = 0; i < ttk_transit_frames; i++) {
-                ttk_ap_fillrect(ttk_screen->srf, ttk_ap_get("window.bg"),
-                                ttk_screen->wx, ttk_screen->wy, ttk_screen->w,
-                                ttk_screen->h);
-                ttk_blit_image_ex(oldwindow->srf, i * jump, 0,
-                                  oldwindow->w - i * jump, oldwindow->h,
-                                  ttk_screen->srf, ttk_screen->wx,
-                                  ttk_screen->wy);
-                ttk_blit_image_ex(
-                    win->srf, 0, 0, i * jump, oldwindow->h, ttk_screen->srf,
-                    oldwindow->w - i * jump + ttk_screen->wx, ttk_screen->wy);
-                ttk_ap_hline(ttk_screen->srf, ttk_ap_get("header.line"), 0,
-                             ttk_screen->w, ttk_screen->wy);
-                ttk_gfx_update(ttk_screen->srf);
-#ifndef IPOD
-                ttk_delay(10);
-#endif
-            }
-            ttk_ap_fillrect(ttk_screen->srf, ttk_ap_get("window.bg"),
-                            ttk_screen->wx, ttk_screen->wy, ttk_screen->w,
-                            ttk_screen->h);
-            ttk_blit_image(win->srf, ttk_screen->srf, ttk_screen->wx,
-                           ttk_screen->wy);
-            ttk_ap_hline(ttk_screen->srf, ttk_ap_get("header.line"), 0,
-                         ttk_screen->w, ttk_screen->wy);
-            ttk_gfx_update(ttk_screen->srf);
+            start_transit(oldwindow, win, 0);
         }
     } else {
         ttk_move_window(win, 0, TTK_MOVE_ABS);
@@ -1182,6 +2311,7 @@ void ttk_show_window(TWindow* win) {
 
     ttk_dirty |= TTK_DIRTY_WINDOWAREA | TTK_DIRTY_HEADER;
     if (ttk_windows->w->input) ttk_dirty |= TTK_DIRTY_INPUT;
+    ttk_trace_end(t0, "show_window", "window", win->title);
 }
 
 void ttk_set_popup(TWindow* win) {
@@ -1224,6 +2354,7 @@ void ttk_popup_window(TWindow* win) {
 
 int ttk_hide_window(TWindow* win) {
     TWindowStack *current = ttk_windows, *last = 0;
+    long long t0 = ttk_trace_begin();
     int ret = 0;
 
     if (!current) return 0;
@@ -1252,41 +2383,11 @@ int ttk_hide_window(TWindow* win) {
 
         if (newwindow->w == win->w && newwindow->h == win->h &&
             newwindow->x == ttk_screen->wx && newwindow->y == ttk_screen->wy) {
-            int i;
-            int jump = win->w / ttk_transit_frames;
-
-            // Render stuff in the new window
-            ttk_fillrect(win->srf, 0, 0, win->w, win->h, ttk_makecol(CKEY));
-            iterate_widgets(win->widgets, do_draw, 1);
-
-            for (i = ttk_transit_frames - 1; i >= 0; i--) {
-                ttk_ap_fillrect(ttk_screen->srf, ttk_ap_get("window.bg"),
-                                ttk_screen->wx, ttk_screen->wy, ttk_screen->w,
-                                ttk_screen->h);
-                ttk_blit_image_ex(newwindow->srf, i * jump, 0,
-                                  win->w - i * jump, win->h, ttk_screen->srf,
-                                  ttk_screen->wx, ttk_screen->wy);
-                ttk_blit_image_ex(
-                    win->srf, 0, 0, i * jump, win->h, ttk_screen->srf,
-                    win->w - i * jump + ttk_screen->wx, ttk_screen->wy);
-                ttk_ap_hline(ttk_screen->srf, ttk_ap_get("header.line"), 0,
-                             ttk_screen->w, ttk_screen->wy);
-                ttk_gfx_update(ttk_screen->srf);
-#ifndef IPOD
-                ttk_delay(10);
-#endif
-            }
-            ttk_ap_fillrect(ttk_screen->srf, ttk_ap_get("window.bg"),
-                            ttk_screen->wx, ttk_screen->wy, ttk_screen->w,
-                            ttk_screen->h);
-            ttk_blit_image(newwindow->srf, ttk_screen->srf, ttk_screen->wx,
-                           ttk_screen->wy);
-            ttk_ap_hline(ttk_screen->srf, ttk_ap_get("header.line"), 0,
-                         ttk_screen->w, ttk_screen->wy);
-            ttk_gfx_update(ttk_screen->srf);
+            start_transit(win, newwindow, 1);
         }
     }
 
+    ttk_trace_end(t0, "hide_window", "window", win->title);
     return ret;
 }
 
@@ -1401,12 +2502,21 @@ void ttk_add_header_widget(TWidget* wid) {
 
     current->v = wid;
     current->next = 0;
+
+    if (wid->schedheap) heap_remove(wid->schedheap, &wid->sched);
+    wid->schedheap = &ttk_header_sched;
+    sched_widget(wid);
 }
 
 void ttk_remove_header_widget(TWidget* wid) {
     TWidgetList *current = ttk_header_widgets, *last = 0;
     if (!current) return;
 
+    if (wid->schedheap == &ttk_header_sched) {
+        heap_remove(&ttk_header_sched, &wid->sched);
+        wid->schedheap = 0;
+    }
+
     while (current) {
         if (current->v == wid) {
             if (last)
@@ -1440,8 +2550,14 @@ TWidget* ttk_new_widget(int x, int y) {
     ret->framedelay = 0;
     ret->timerlast = 0;
     ret->timerdelay = 0;
+    ret->framefps = ret->framerem = ret->frameacc = 0;
+    ret->sched.slot = -1;
+    ret->sched.owner = ret;
+    ret->schedheap = 0;
     ret->holdtime = 1000;
     ret->dirty = 1;
+    ret->win = 0;
+    ret->type = "widget";
 
     ret->draw = ttk_widget_nodrawing;
     ret->button = ttk_widget_noaction_2;
@@ -1459,6 +2575,8 @@ void ttk_free_widget(TWidget* wid) {
 
     wid->destroy(wid);
     if (wid->win) ttk_remove_widget(wid->win, wid);
+    if (wid->schedheap) heap_remove(wid->schedheap, &wid->sched);
+    if (running_wid == wid) running_wid = 0;
     free(wid);
 }
 
@@ -1483,6 +2601,11 @@ TWindow* ttk_add_widget(TWindow* win, TWidget* wid) {
     current->v = wid;
     current->next = 0;
 
+    if (!win->sched) win->sched = calloc(1, sizeof(ttk_heap));
+    if (wid->schedheap) heap_remove(wid->schedheap, &wid->sched);
+    wid->schedheap = win->sched;
+    sched_widget(wid);
+
     return win;
 }
 
@@ -1515,27 +2638,39 @@ int ttk_remove_widget(TWindow* win, TWidget* wid) {
 
     win->dirty++;
     wid->win = 0;
+    if (wid->schedheap && wid->schedheap == win->sched) {
+        heap_remove(win->sched, &wid->sched);
+        wid->schedheap = 0;
+    }
 
     return count;
 }
 
 void ttk_widget_set_fps(TWidget* wid, int fps) {
-    if (fps) {
+    if (fps > 0) {
         wid->framelast = ttk_getticks();
         wid->framedelay = 1000 / fps;
+        wid->framefps = fps;
+        wid->framerem = 1000 % fps;
     } else {
         wid->framelast = wid->framedelay = 0;
+        wid->framefps = wid->framerem = 0;
     }
+    wid->frameacc = 0;
+    sched_widget(wid);
 }
 
 void ttk_widget_set_inv_fps(TWidget* wid, int fps_m1) {
     wid->framelast = ttk_getticks();
     wid->framedelay = 1000 * fps_m1;  // works for 0 to unset
+    wid->framefps = wid->framerem = wid->frameacc = 0;
+    sched_widget(wid);
 }
 
 void ttk_widget_set_timer(TWidget* wid, int ms) {
     wid->timerlast = ttk_getticks();
     wid->timerdelay = ms;  // works for 0 to unset
+    sched_widget(wid);
 }
 
 void ttk_set_global_event_handler(int (*fn)(int ev, int earg, int time)) {
@@ -1807,76 +2942,112 @@ void ttk_sleep_cop() {}
 
 void ttk_wake_cop() {}
 
-/* don't hurt yourself; I know I did. */
+// Timers are carved out of blocks that are never moved, and reused once
+// they fire or are destroyed. So that an old handle can't reach whatever
+// timer has its slot now, a handle is the slot's index in the low 32 bits
+// and the slot's generation in the high 32, which wraps only after four
+// billion reuses of the one slot. Generation 0 is skipped, so no handle is 0.
+#define TIMER_BLOCK 64
+static ttk_timer_slot** timer_blocks = 0;
+static unsigned int timer_nblocks = 0;
+static unsigned int timer_gen0 = 1;  // for slots made after a reset
+
+static ttk_timer timer_handle(ttk_timer_slot* t) {
+    return (ttk_timer)t->gen << 32 | t->index;
+}
+
+// The queued timer [h] is a handle to, or 0.
+static ttk_timer_slot* timer_of(ttk_timer h) {
+    unsigned int index = (unsigned int)(h & 0xffffffffu);
+    ttk_timer_slot* t;
+
+    if (index / TIMER_BLOCK >= timer_nblocks) return 0;
+    t = &timer_blocks[index / TIMER_BLOCK][index % TIMER_BLOCK];
+    if (timer_handle(t) != h || t->ent.slot < 0) return 0;
+    return t;
+}
+
+static void timer_release(ttk_timer_slot* t) {
+    heap_remove(&ttk_timers, &t->ent);
+    if (!++t->gen) t->gen = 1;
+    t->next = ttk_free_timers;
+    ttk_free_timers = t;
+}
+
 ttk_timer ttk_create_timer(int ms, void (*fn)()) {
-#define TIMER_ALLOCD (head->delay)
-    /* yes, static variables are not entirely clean, but timers will probably
-     * be running until program exit, if not call ttk_create_timer with 0,0 */
-    static ttk_timer head;
-    ttk_timer cur;
-    int num;
-
-    /* special case so that -head- can be free'd */
+    ttk_timer_slot* cur;
+    unsigned int i, j;
+
+    /* special case to cancel every timer and free their memory */
     if (!ms && !fn) {
-        free(head);
-        head = 0;
+        for (i = 0; i < timer_nblocks; i++) {
+            for (j = 0; j < TIMER_BLOCK; j++)
+                if (timer_blocks[i][j].gen >= timer_gen0)
+                    timer_gen0 = timer_blocks[i][j].gen + 1;
+            free(timer_blocks[i]);
+        }
+        if (!timer_gen0) timer_gen0 = 1;
+        free(timer_blocks);
+        free(ttk_timers.v);
+        timer_blocks = 0;
+        timer_nblocks = 0;
+        ttk_free_timers = 0;
+        ttk_timers.v = 0;
+        ttk_timers.n = ttk_timers.alloc = 0;
         return 0;
     }
-    /* count the number of timers used */
-    for (cur = head; cur && cur->next; cur = cur->next);
-    num = (cur) ? cur - head : 0;
-
-    /* if ttk_timers moved, make sure we don't leave a empty timer spot */
-    if (head && ttk_timers && ttk_timers != head->next) {
-        head->next = ttk_timers;
-    }
-    if (!head || ++num > TIMER_ALLOCD) {
-        int a = head ? TIMER_ALLOCD + 64 : 63;
-        /* if this realloc relocates the memory, all timers are screwed. */
-        cur = realloc(head, (a + 1) * sizeof(struct _ttk_timer));
-        if (head && cur != head) {
-            fprintf(stderr,
-                    "realloc relocated timers. All timers are now "
-                    "broken. Why did you have over %d timers anyway? "
-                    "Please report.",
-                    a - 64);
+
+    if (!ttk_free_timers) {
+        cur = malloc(TIMER_BLOCK * sizeof(ttk_timer_slot));
+        timer_blocks =
+            realloc(timer_blocks, (timer_nblocks + 1) * sizeof(*timer_blocks));
+        for (i = 0; i < TIMER_BLOCK; i++) {
+            cur[i].ent.slot = -1;
+            cur[i].ent.owner = &cur[i];
+            cur[i].gen = timer_gen0;
+            cur[i].index = timer_nblocks * TIMER_BLOCK + i;
+            cur[i].next = (i + 1 < TIMER_BLOCK) ? &cur[i + 1] : 0;
         }
-        if (!head) cur->next = 0;
-        head = cur;
-        TIMER_ALLOCD = a;
+        timer_blocks[timer_nblocks++] = cur;
+        ttk_free_timers = cur;
     }
 
-    cur = head;
-    while (cur->next == cur + 1) cur = cur->next;
-    (cur + 1)->next = cur->next;
-    cur->next = cur + 1;
-    cur = cur->next;
-    /* reset ttk_timers so we aren't missing a timer in spot 1 */
-    ttk_timers = head->next;
+    cur = ttk_free_timers;
+    ttk_free_timers = cur->next;
+    cur->next = 0;
 
     cur->started = ttk_getticks();
     cur->delay = ms;
     cur->fn = fn;
-    return cur;
-#undef TIMER_ALLOCD
+    cur->ent.due = cur->started + ms;
+    heap_push(&ttk_timers, &cur->ent);
+    return timer_handle(cur);
+}
+#undef TIMER_BLOCK
+
+int ttk_timer_get_started(ttk_timer tim) {
+    ttk_timer_slot* t = timer_of(tim);
+    return t ? t->started : -1;
+}
+
+int ttk_timer_get_delay(ttk_timer tim) {
+    ttk_timer_slot* t = timer_of(tim);
+    return t ? t->delay : -1;
+}
+
+void (*ttk_timer_get_fn(ttk_timer tim))() {
+    ttk_timer_slot* t = timer_of(tim);
+    return t ? t->fn : 0;
 }
 
 void ttk_destroy_timer(ttk_timer tim) {
-    ttk_timer cur = ttk_timers, last = 0;
-    while (cur && (cur != tim)) {
-        last = cur;
-        cur = cur->next;
-    }
-    if (cur != tim) {
-        fprintf(stderr, "Warning: didn't delete nonexistent timer %p\n", tim);
-        return;
-    }
+    ttk_timer_slot* t = timer_of(tim);
 
-    if (last) {
-        last->next = cur->next;
-    } else {
-        ttk_timers = cur->next;
+    if (!t) {
+        fprintf(stderr, "Warning: didn't delete nonexistent timer %llx\n", tim);
+        return;
     }
+    timer_release(t);
 }
 
 void ttk_set_transition_frames(int frames) {
@@ -1940,8 +3111,8 @@ void ttk_input_size_for(TWindow* win, int* w, int* h) {
 void ttk_input_char(int ch) {
     if (!ttk_windows || !ttk_windows->w) return;
 
-    ttk_windows->w->inbuf[ttk_windows->w->inbuf_end++] = ch;
-    ttk_windows->w->inbuf_end &= 0x1f;
+    if (!evq_post(TTK_TEXT, ch, ttk_getticks()))
+        fprintf(stderr, "Input queue full, dropped character %d\n", ch);
 }
 
 void ttk_input_end() {